@@ -10,6 +10,9 @@
 import os
 
 BLOCK_SIZE = 16
+# CFB segment size in bits. The bootloader decrypts this mode natively, see
+# bootloader/src/pyi_aes.c.
+SEGMENT_SIZE = 128
 
 
 def import_aes(module_name):
@@ -61,4 +64,5 @@ class PyiBlockCipher(object):
         # The 'BlockAlgo' class is stateful, this factory method is used to
         # re-initialize the block cipher class with each call to encrypt() and
         # decrypt().
-        return self._aesmod.new(self.key.encode(), self._aesmod.MODE_CFB, iv)
+        return self._aesmod.new(self.key.encode(), self._aesmod.MODE_CFB, iv,
+                                segment_size=SEGMENT_SIZE)
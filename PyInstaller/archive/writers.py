@@ -21,6 +21,8 @@ files into the executable.
 # See pyi_carchive.py for a more general archive (contains anything)
 # that can be understood by a C program.
 
+import collections
+import heapq
 import os
 import sys
 import struct
@@ -31,7 +33,8 @@ import zlib
 from PyInstaller.building.utils import get_code_object, strip_paths_in_code,\
     fake_pyc_timestamp
 from PyInstaller.loader.pyimod02_archive import PYZ_TYPE_MODULE, PYZ_TYPE_PKG, \
-    PYZ_TYPE_DATA
+    PYZ_TYPE_DATA, PYZ_TYPE_DATA_STORED, PYZ_CIPHER_NONE, PYZ_CIPHER_CFB128, \
+    PYZ_FLAG_UNCOMPRESSED
 from ..compat import BYTECODE_MAGIC, is_py2
 
 
@@ -116,6 +119,26 @@ class ArchiveWriter(object):
             f.seek(8)  # skip magic and timestamp
             self.lib.write(f.read())
 
+    def _add_digests(self, tocpos):
+        """
+        Write the digests entry (type 'h') at TOCPOS and add it to the table
+        of contents, so the bootloader can detect a corrupt archive.
+
+        It holds, as unsigned 32-bit integers in network byte order, the
+        number of the other entries, the CRC-32 of the stored (compressed)
+        data of each of them in TOC order and the CRC-32 of the table of
+        contents itself, including the record of this entry.
+
+        Return the new position and the binary form of the table of contents.
+        """
+        count = len(self._digests)
+        dlen = 4 * (count + 2)
+        self.toc.add(tocpos, dlen, dlen, 0, 'h', 'pyi-digests')
+        tocstr = self.toc.tobinary()
+        digests = [count] + self._digests + [zlib.crc32(tocstr) & 0xffffffff]
+        self.lib.write(struct.pack('!%dI' % len(digests), *digests))
+        return tocpos + dlen, tocstr
+
     def save_trailer(self, tocpos):
         """
         Default - toc is a dict
@@ -159,6 +182,62 @@ class ArchiveWriter(object):
         self.lib.write(struct.pack('!i', tocpos))
 
 
+def train_zdict(samples, size, dmer=8, segment=64, max_input=1 << 20):
+    """
+    Build a zlib preset dictionary of at most `size` bytes for compressing
+    each of `samples` (a list of byte strings) on its own.
+
+    Every `dmer`-byte string is scored by the number of samples it occurs
+    in; strings found in a single sample gain nothing from a dictionary. The
+    dictionary is made of the `segment`-byte slices of the samples that
+    contain the most valuable strings not yet in the dictionary. The best
+    slices go to the end, where zlib reaches them with the shortest
+    distances.
+
+    Only about `max_input` bytes of the samples are used for training.
+    """
+    total = sum(len(data) for data in samples)
+    samples = samples[::total // max_input + 1]
+    freq = collections.Counter()
+    for data in samples:
+        freq.update(set(data[i:i + dmer]
+                        for i in range(len(data) - dmer + 1)))
+
+    # Score each slice by a few of its d-mers: exact enough for ranking.
+    offsets = range(0, segment - dmer + 1, dmer // 2)
+
+    def score(data, covered):
+        return sum(freq[k] for k in set(data[i:i + dmer] for i in offsets)
+                   if freq[k] > 1 and k not in covered)
+
+    heap = []
+    for data in samples:
+        for pos in range(0, len(data) - segment + 1, segment // 2):
+            value = score(data[pos:pos + segment], ())
+            if value:
+                heap.append((-value, len(heap), data[pos:pos + segment]))
+    heapq.heapify(heap)
+
+    # Greedy selection. The scores in the heap are upper bounds, a slice is
+    # taken once its updated score still leads.
+    covered = set()
+    chosen = []
+    length = 0
+    while heap and length + segment <= size:
+        value, order, data = heapq.heappop(heap)
+        value = -score(data, covered)
+        if not value:
+            continue
+        if heap and value > heap[0][0]:
+            heapq.heappush(heap, (value, order, data))
+            continue
+        covered.update(data[i:i + dmer] for i in offsets)
+        chosen.append(data)
+        length += segment
+    chosen.reverse()
+    return b''.join(chosen)
+
+
 class ZlibArchiveWriter(ArchiveWriter):
     """
     ZlibArchive - an archive with compressed entries. Archive is read
@@ -168,25 +247,140 @@ class ZlibArchiveWriter(ArchiveWriter):
 
     NOTE: The whole ZlibArchive (PYZ) is compressed so it is not necessary
           to compress single modules with zlib.
+
+    The last four bytes of the header give the length of a zlib preset
+    dictionary stored, compressed (and encrypted) like an entry, right after
+    the header. All entries are compressed with it. A length of 0 means
+    there is no dictionary. A dictionary is only trained on request: all
+    entries are then held in memory and compressed twice, with and without
+    it.
+
+    With a block size, small entries are packed in TOC order into blocks of
+    about that many bytes, which are compressed as a whole. A block holds
+    modules of one top-level package where possible. The TOC record of an
+    entry in a block is (typ, pos, length, offset, ulen): the block is
+    stored at pos, and the entry is the ulen bytes at offset in the
+    decompressed block.
+
+    Data entries that do not compress well are stored as they are, with the
+    type PYZ_TYPE_DATA_STORED.
+
+    Without compression, all entries are stored as they are, and the header
+    has the flag PYZ_FLAG_UNCOMPRESSED. The loader then maps the archive and
+    unmarshals the code straight from the mapping, so the processes running
+    the application share the pages of the file.
     """
     MAGIC = b'PYZ\0'
     TOCPOS = 8
-    HDRLEN = ArchiveWriter.HDRLEN + 5
+    HDRLEN = ArchiveWriter.HDRLEN + 6
     COMPRESSION_LEVEL = 6  # Default level of the 'zlib' module from Python.
+    # zlib uses at most the last 32 KiB of a preset dictionary.
+    ZDICT_SIZE = 32 * 1024
 
-    def __init__(self, archive_path, logical_toc, code_dict=None, cipher=None):
+    def __init__(self, archive_path, logical_toc, code_dict=None, cipher=None,
+                 block_size=0, compress=True, zdict=False):
         """
         code_dict      dict containing module code objects from ModuleGraph.
+        block_size     size of the blocks entries are packed into, or 0 to
+                       compress each entry on its own.
+        compress       False to store all entries without compression.
+        zdict          True to compress the entries with a preset dictionary
+                       trained on them (Python 3).
         """
         # Keep references to module code objects constructed by ModuleGraph
         # to avoid writting .pyc/pyo files to hdd.
         self.code_dict = code_dict or {}
         self.cipher = cipher or None
+        self.block_size = block_size if compress else 0
+        self.compress = compress
+        self.use_zdict = zdict and compress and not is_py2
+        self.zdict = b''
+        self._zdict_obj = b''
 
         super(ZlibArchiveWriter, self).__init__(archive_path, logical_toc)
 
+    def _add_from_table_of_contents(self, toc):
+        """
+        Group the entries into blocks, and with zdict train a preset
+        dictionary on all entries and write it, then add the entries. The
+        dictionary is kept only if it makes the archive smaller.
+        """
+        if not self.block_size and not self.use_zdict:
+            # One entry at a time, without holding all of them in memory.
+            super(ZlibArchiveWriter, self)._add_from_table_of_contents(toc)
+            return
+        entries = [self._get_entry_data(toc_entry) for toc_entry in toc]
+        groups = self._group_entries(entries)
+        blocks = [b''.join(data for name, typ, data in group)
+                  for group in groups]
+        compressed = [self._compress(block, b'') for block in blocks]
+        if self.use_zdict and entries:
+            zdict = train_zdict([data for name, typ, data in entries],
+                                self.ZDICT_SIZE)
+            if zdict:
+                obj = self._encrypt(zlib.compress(zdict, 9))
+                primed = [self._compress(block, zdict) for block in blocks]
+                if (len(obj) + sum(len(c) for c in primed) <
+                        sum(len(c) for c in compressed)):
+                    self.zdict = zdict
+                    self._zdict_obj = obj
+                    self.lib.write(obj)
+                    compressed = primed
+        for group, obj in zip(groups, compressed):
+            self._add_compressed(group, obj)
+
+    def _group_entries(self, entries):
+        """
+        Split the (name, typ, data) entries into the groups stored as one
+        compressed block, see the class documentation.
+        """
+        if not self.block_size:
+            return [[entry] for entry in entries]
+        groups = []
+        group = []
+        size = 0
+        for entry in entries:
+            name, typ, data = entry
+            if len(data) >= self.block_size // 2:
+                # Big entries gain little and are stored on their own.
+                groups.append([entry])
+                continue
+            # Start a new block when this one is full, or when it is half full
+            # and a new top-level package starts.
+            if group and (size + len(data) > self.block_size or
+                          (size >= self.block_size // 2 and
+                           name.split('.')[0] != group[-1][0].split('.')[0])):
+                groups.append(group)
+                group = []
+                size = 0
+            group.append(entry)
+            size += len(data)
+        if group:
+            groups.append(group)
+        return groups
+
+    def _compress(self, data, zdict):
+        if not zdict:
+            return zlib.compress(data, self.COMPRESSION_LEVEL)
+        comp = zlib.compressobj(self.COMPRESSION_LEVEL, zdict=zdict)
+        return comp.compress(data) + comp.flush()
+
+    def _encrypt(self, obj):
+        if self.cipher:
+            obj = self.cipher.encrypt(obj)
+        return obj
 
     def add(self, entry):
+        entry = self._get_entry_data(entry)
+        if self.compress:
+            self._add_compressed([entry], self._compress(entry[2], self.zdict))
+        else:
+            self._add_compressed([entry], entry[2])
+
+    def _get_entry_data(self, entry):
+        """
+        Return the name, PYZ type and uncompressed data of a TOC entry.
+        """
         name, path, typ = entry
         if typ == 'PYMODULE':
             typ = PYZ_TYPE_MODULE
@@ -207,22 +401,42 @@ class ZlibArchiveWriter(ArchiveWriter):
                 data = fh.read()
             # No need to use forward slash as path-separator here since
             # pkg_resources on Windows back slash as path-separator.
+        return name, typ, data
 
-        obj = zlib.compress(data, self.COMPRESSION_LEVEL)
-
+    def _add_compressed(self, group, obj):
+        """
+        Write the compressed data of the entries in 'group' and add them to
+        the TOC.
+        """
+        name, typ, data = group[0]
+        if (len(group) == 1 and typ == PYZ_TYPE_DATA and
+                (not self.compress or len(obj) >= len(data) - len(data) // 8)):
+            # Compression saves little, store the data instead. The loader
+            # can then stream it straight from the archive.
+            typ = PYZ_TYPE_DATA_STORED
+            obj = data
         # First compress then encrypt.
-        if self.cipher:
-            obj = self.cipher.encrypt(obj)
-
-        self.toc.append((name, (typ, self.lib.tell(), len(obj))))
+        obj = self._encrypt(obj)
+        pos = self.lib.tell()
+        if len(group) == 1:
+            self.toc.append((name, (typ, pos, len(obj))))
+        else:
+            offset = 0
+            for name, typ, data in group:
+                self.toc.append((name, (typ, pos, len(obj), offset, len(data))))
+                offset += len(data)
         self.lib.write(obj)
 
     def update_headers(self, tocpos):
         """
-        add level
+        add the flags, the cipher mode and the length of the preset dictionary
         """
         ArchiveWriter.update_headers(self, tocpos)
-        self.lib.write(struct.pack('!B', self.cipher is not None))
+        self.lib.write(struct.pack(
+            '!B', 0 if self.compress else PYZ_FLAG_UNCOMPRESSED))
+        self.lib.write(struct.pack(
+            '!B', PYZ_CIPHER_CFB128 if self.cipher else PYZ_CIPHER_NONE))
+        self.lib.write(struct.pack('!I', len(self._zdict_obj)))
 
 
 
@@ -340,6 +554,7 @@ class CArchiveWriter(ArchiveWriter):
         super(CArchiveWriter, self)._start_add_entries(path)
         # Override parents' toc {} with a class.
         self.toc = CTOC()
+        self._digests = []
 
     def add(self, entry):
         """
@@ -385,6 +600,13 @@ class CArchiveWriter(ArchiveWriter):
             raise
 
         where = self.lib.tell()
+        # CRC-32 of the data as stored, see _add_digests().
+        crc = [0]
+
+        def write(data):
+            crc[0] = zlib.crc32(data, crc[0])
+            self.lib.write(data)
+
         assert flag in range(3)
         if not fh and not code_data:
             # no need to write anything
@@ -392,7 +614,7 @@ class CArchiveWriter(ArchiveWriter):
         elif flag == 1:
             comprobj = zlib.compressobj(self.LEVEL)
             if code_data is not None:
-                self.lib.write(comprobj.compress(code_data))
+                write(comprobj.compress(code_data))
             else:
                 assert fh
                 # We only want to change it for pyc files
@@ -404,19 +626,19 @@ class CArchiveWriter(ArchiveWriter):
                     if modify_header:
                         modify_header = False
                         buf = fake_pyc_timestamp(buf)
-                    self.lib.write(comprobj.compress(buf))
-            self.lib.write(comprobj.flush())
+                    write(comprobj.compress(buf))
+            write(comprobj.flush())
 
         else:
             if code_data is not None:
-                self.lib.write(code_data)
+                write(code_data)
             else:
                 assert fh
                 while 1:
                     buf = fh.read(16*1024)
                     if not buf:
                         break
-                    self.lib.write(buf)
+                    write(buf)
 
         dlen = self.lib.tell() - where
         if typcd == 'm':
@@ -428,6 +650,7 @@ class CArchiveWriter(ArchiveWriter):
 
         # Record the entry in the CTOC
         self.toc.add(where, dlen, ulen, flag, typcd, nm)
+        self._digests.append(crc[0] & 0xffffffff)
 
 
     def save_trailer(self, tocpos):
@@ -438,7 +661,7 @@ class CArchiveWriter(ArchiveWriter):
         CArchives can be opened from the end - the cookie points
         back to the start.
         """
-        tocstr = self.toc.tobinary()
+        tocpos, tocstr = self._add_digests(tocpos)
         self.lib.write(tocstr)
         toclen = len(tocstr)
 
@@ -23,10 +23,11 @@ from operator import itemgetter
 from PyInstaller import HOMEPATH, PLATFORM
 from PyInstaller.archive.writers import ZlibArchiveWriter, CArchiveWriter
 from PyInstaller.building.utils import _check_guts_toc, add_suffix_to_extensions, \
-    checkCache, strip_paths_in_code, get_code_object, \
-    _make_clean_directory
-from PyInstaller.compat import is_win, is_darwin, is_linux, is_cygwin, exec_command_all
-from PyInstaller.depend import bindepend
+    checkCache, strip_paths_in_code, get_code_object, slim_code, \
+    _make_clean_directory, write_extension_index, EXTENSION_INDEX
+from PyInstaller.compat import is_win, is_darwin, is_linux, is_cygwin, is_py2, \
+    is_py3, exec_command_all, which
+from PyInstaller.depend import bindepend, dylib
 from PyInstaller.depend.analysis import get_bootstrap_modules
 from PyInstaller.depend.utils import is_path_to_egg
 from PyInstaller.building.datastruct import TOC, Target, _check_guts_eq
@@ -63,6 +64,52 @@ class PYZ(Target):
                 name will do fine.
             cipher
                 The block cipher that will be used to encrypt Python bytecode.
+            block_size
+                Pack the modules into compressed blocks of about this many
+                bytes (e.g. 128 * 1024) instead of compressing each module on
+                its own. This makes the archive smaller, and importing many
+                modules of a package decompresses a few blocks only. The
+                default, 0, keeps one module per compressed entry.
+            compress
+                False to store the modules without compression. The archive
+                is larger, but the application maps it read-only and
+                unmarshals the code straight from the mapping (Python 3), so
+                processes running the application at the same time share
+                one copy of it in the page cache, and no time is spent on
+                decompression. Ignores block_size.
+            zdict
+                Python 3 only. True to compress the modules with a zlib
+                preset dictionary trained on them, which makes the archive
+                about 10% smaller. The build then holds all modules in
+                memory and compresses them twice, so it is slower.
+            strip_docstrings
+                Remove the docstrings from the code of modules, as with
+                ``python -OO``. True for all modules, or a list of names of
+                modules and packages. Modules that use their docstrings at
+                run time (e.g. for command line help) must not be listed.
+            strip_asserts
+                Remove assert statements, as with ``python -O``. True or a
+                list of names, see above.
+            strip_line_numbers
+                Remove the line number tables from the code (up to Python
+                3.9). Tracebacks then show the first line of each function
+                only. True or a list of names, see above.
+            merge_constants
+                Store equal string constants of a module once (up to Python
+                3.7, later versions do this when compiling). True or a list
+                of names, see above.
+            lazy_modules
+                Python 3.5+ only. Import these modules lazily: importing one
+                only creates the module object, its code is decompressed and
+                run on first attribute access, as with
+                importlib.util.LazyLoader. True for all modules in the PYZ,
+                or a list of names of modules and packages. Modules that
+                must run when imported (e.g. to register something) must
+                not be lazy. ``from module import name`` runs the module
+                immediately.
+            lazy_excludes
+                A list of names of modules and packages that are imported
+                as usual although lazy_modules selects them.
 
         """
 
@@ -70,6 +117,15 @@ class PYZ(Target):
         Target.__init__(self)
         name = kwargs.get('name', None)
         cipher = kwargs.get('cipher', None)
+        self.block_size = kwargs.get('block_size', 0)
+        self.compress = kwargs.get('compress', True)
+        self.zdict = kwargs.get('zdict', False)
+        self.slim_options = dict(
+            (option, kwargs.get(option, False))
+            for option in ('strip_docstrings', 'strip_asserts',
+                           'strip_line_numbers', 'merge_constants'))
+        self.lazy_modules = kwargs.get('lazy_modules', None)
+        self.lazy_excludes = kwargs.get('lazy_excludes', None) or []
         self.toc = TOC()
         # If available, use code objects directly from ModuleGraph to
         # speed up PyInstaller.
@@ -92,6 +148,21 @@ class PYZ(Target):
             # Insert the key as the first module in the list. The key module contains
             # just variables and does not depend on other modules.
             self.dependencies.insert(0, key_file)
+        # The loader maps uncompressed archives with the 'mmap' module.
+        if not self.compress:
+            import mmap  # C extension.
+            if hasattr(mmap, '__file__'):
+                self.dependencies.append(
+                    ('mmap', os.path.abspath(mmap.__file__), 'EXTENSION'))
+        # Pass the modules to import lazily to the FrozenImporter.
+        if self.lazy_modules:
+            lazy_file = os.path.join(CONF['workpath'],
+                                     'pyimod00_lazy_modules.py')
+            with open(lazy_file, 'w') as f:
+                f.write('modules = %r\nexcludes = %r\n'
+                        % (self.lazy_modules, list(self.lazy_excludes)))
+            self.dependencies.insert(0, ('pyimod00_lazy_modules',
+                                         lazy_file + 'c', 'PYMODULE'))
         # Compile the top-level modules so that they end up in the CArchive and can be
         # imported by the bootstrap script.
         self.dependencies = misc.compile_py_files(self.dependencies, CONF['workpath'])
@@ -100,6 +171,12 @@ class PYZ(Target):
     _GUTS = (# input parameters
             ('name', _check_guts_eq),
             ('toc', _check_guts_toc),  # todo: pyc=1
+            ('block_size', _check_guts_eq),
+            ('compress', _check_guts_eq),
+            ('zdict', _check_guts_eq),
+            ('slim_options', _check_guts_eq),
+            ('lazy_modules', _check_guts_eq),
+            ('lazy_excludes', _check_guts_eq),
             # no calculated/analysed values
             )
 
@@ -124,13 +201,22 @@ class PYZ(Target):
         # sort content alphabetically to support reproducible builds
         toc.sort()
 
+        # Slim down the code objects as requested.
+        if any(self.slim_options.values()):
+            for name, path, typ in toc:
+                if typ == 'PYMODULE':
+                    self.code_dict[name] = slim_code(
+                        name, path, self.code_dict[name], **self.slim_options)
+
         # Remove leading parts of paths in code objects
         self.code_dict = {
             key: strip_paths_in_code(code)
             for key, code in self.code_dict.items()
         }
 
-        pyz = ZlibArchiveWriter(self.name, toc, code_dict=self.code_dict, cipher=self.cipher)
+        pyz = ZlibArchiveWriter(self.name, toc, code_dict=self.code_dict,
+                                cipher=self.cipher, block_size=self.block_size,
+                                compress=self.compress, zdict=self.zdict)
         logger.info("Building PYZ (ZlibArchive) %s completed successfully.",
                     self.name)
 
@@ -144,6 +230,7 @@ class PKG(Target):
     typ = 'PKG'
     xformdict = {'PYMODULE': 'm',
                  'PYSOURCE': 's',
+                 'PYFROZEN': 'f',
                  'EXTENSION': 'b',
                  'PYZ': 'z',
                  'PKG': 'a',
@@ -190,6 +277,7 @@ class PKG(Target):
                           'EXECUTABLE': COMPRESSED,
                           'PYSOURCE': COMPRESSED,
                           'PYMODULE': COMPRESSED,
+                          'PYFROZEN': COMPRESSED,
                           # Do not compress PYZ as a whole. Single modules are
                           # compressed when creating PYZ archive.
                           'PYZ': UNCOMPRESSED}
@@ -269,6 +357,15 @@ class PKG(Target):
             else:
                 mytoc.append((inm, fnm, self.cdict.get(typ, 0), self.xformdict.get(typ, 'b')))
 
+        # Let the bootloader's importers find the extension modules without
+        # searching sys.path.
+        if is_py3 and not self.exclude_binaries:
+            index = os.path.splitext(self.name)[0] + '-' + EXTENSION_INDEX
+            if write_extension_index(index, self.toc):
+                mytoc.append((EXTENSION_INDEX, index,
+                              self.cdict.get('DATA', 0), 'x'))
+            trash.append(index)
+
         # Bootloader has to know the name of Python library. Pass python libname to CArchive.
         pylib_name = os.path.basename(bindepend.get_python_library_path())
 
@@ -319,6 +416,58 @@ class EXE(Target):
                 appended.
             exclude_binaries
                 Forwarded to the PKG the EXE builds.
+            pipelined_extraction
+                Non-Windows onefile only. If True, the bootloader starts the
+                application as soon as the files needed to start Python are
+                extracted, and extracts binaries inside packages and data
+                files while the application starts. Python modules added as
+                data files and distribution metadata (*.dist-info,
+                *.egg-info) are extracted before. The first import not
+                served from the PYZ archive waits until all files are
+                complete, and so does open() of a data file before that.
+                Other access to the files before that import does not wait:
+                os.path.exists(), os.stat(), os.listdir() and glob may miss
+                files, and files opened from C code (e.g. a CA bundle passed
+                to ssl, Qt plugins) may be missing. Call
+                pyimod03_importers.wait_for_extraction(path) first in such
+                cases, e.g. in a runtime hook. Python 3 only.
+            detached_cleanup
+                Non-Windows onefile only. If True, the temporary directory is
+                removed by a detached background process, so the executable
+                exits as soon as the application has finished instead of
+                waiting for all extracted files to be deleted.
+            linux_single_process
+                Linux onedir only. If True, COLLECT sets the RUNPATH of the
+                collected binaries relative to '$ORIGIN' (requires
+                'patchelf'), so that the bootloader can run the application
+                in a single process instead of re-executing itself with
+                LD_LIBRARY_PATH set. Only the RUNPATH of the collected
+                binaries points to the bundle: ctypes.CDLL('libfoo.so.1')
+                by soname and subprocesses no longer find the bundled
+                libraries. Load them by full path, under sys._MEIPASS, and
+                set LD_LIBRARY_PATH for subprocesses that need them.
+            zygote
+                Non-Windows only. True or a list of module names. The first
+                run starts a background server which initializes Python,
+                imports the listed modules and waits for later runs of the
+                same executable by the same user. These then run in a fork
+                of the server instead of starting Python from scratch. The
+                server exits after 10 minutes without runs. Python 3 only.
+            readahead
+                Non-Windows only. True or a list of names. When the
+                application starts, a background process asks the kernel to
+                read the listed files or directories (relative to the
+                application directory) and PYZ archives into the page cache,
+                so that disk reads overlap with the initialization of Python.
+                With True, the PYZ archives and, in onedir mode, all files of
+                at least 1 MB are read ahead.
+            entrypoints
+                A list of the names of scripts from Analysis (without '.py'),
+                to build one executable for several programs. Only one of
+                them is run: the one named like the executable it was
+                started as (e.g. a symbolic link or a copy), or else the one
+                named by the first argument, which then becomes sys.argv[0].
+                The other scripts (bootstrap and runtime hooks) always run.
             icon
                 Windows or OSX only. icon='myicon.ico' to use an icon file or
                 icon='notepad.exe,0' to grab an icon resource.
@@ -350,6 +499,12 @@ class EXE(Target):
         self.resources = kwargs.get('resources', [])
         self.strip = kwargs.get('strip', False)
         self.runtime_tmpdir = kwargs.get('runtime_tmpdir', None)
+        self.pipelined_extraction = kwargs.get('pipelined_extraction', False)
+        self.detached_cleanup = kwargs.get('detached_cleanup', False)
+        self.linux_single_process = kwargs.get('linux_single_process', False)
+        self.zygote = kwargs.get('zygote', False)
+        self.readahead = kwargs.get('readahead', False)
+        self.entrypoints = kwargs.get('entrypoints', None)
         # If ``append_pkg`` is false, the archive will not be appended
         # to the exe, but copied beside it.
         self.append_pkg = kwargs.get('append_pkg', True)
@@ -404,6 +559,58 @@ class EXE(Target):
             # no value; presence means "true"
             self.toc.append(("pyi-bootloader-ignore-signals", "", "OPTION"))
 
+        if self.pipelined_extraction:
+            if is_py2:
+                logger.warning("pipelined_extraction requires Python 3, ignored.")
+            else:
+                self.toc.append(("pyi-pipelined-extraction", "", "OPTION"))
+
+        if self.detached_cleanup:
+            # no value; presence means "true"
+            self.toc.append(("pyi-detached-cleanup", "", "OPTION"))
+
+        if self.linux_single_process:
+            if not is_linux or not self.exclude_binaries:
+                logger.warning("linux_single_process applies only to onedir "
+                               "mode on Linux, ignored.")
+                self.linux_single_process = False
+            elif not which('patchelf'):
+                logger.warning("linux_single_process requires 'patchelf', "
+                               "ignored.")
+                self.linux_single_process = False
+            else:
+                # no value; presence means "true"
+                self.toc.append(("pyi-linux-single-process", "", "OPTION"))
+
+        if self.zygote:
+            if is_py2 or is_win:
+                logger.warning("zygote requires Python 3 and is not "
+                               "available on Windows, ignored.")
+            elif self.zygote is True:
+                self.toc.append(("pyi-zygote", "", "OPTION"))
+            else:
+                self.toc.append(("pyi-zygote " + ",".join(self.zygote), "",
+                                 "OPTION"))
+
+        if self.readahead:
+            if is_win:
+                logger.warning("readahead is not available on Windows, "
+                               "ignored.")
+            elif self.readahead is True:
+                self.toc.append(("pyi-readahead", "", "OPTION"))
+            else:
+                self.toc.append(("pyi-readahead " + ",".join(self.readahead),
+                                 "", "OPTION"))
+
+        if self.entrypoints:
+            scripts = [nm for nm, path, typ in self.toc if typ == 'PYSOURCE']
+            for nm in self.entrypoints:
+                if nm not in scripts or ',' in nm:
+                    raise SystemExit('Entry point %r is not the name of a '
+                                     'script.' % nm)
+            self.toc.append(("pyi-entrypoints " + ",".join(self.entrypoints),
+                             "", "OPTION"))
+
         if is_win:
             filename = os.path.join(CONF['workpath'], CONF['specnm'] + ".exe.manifest")
             self.manifest = winmanifest.create_manifest(filename, self.manifest,
@@ -642,6 +849,7 @@ class COLLECT(Target):
         Target.__init__(self)
         self.strip_binaries = kws.get('strip', False)
         self.console = True
+        self.set_runpath = False
 
         if CONF['hasUPX']:
             self.upx_binaries = kws.get('upx', False)
@@ -665,6 +873,7 @@ class COLLECT(Target):
                 self.toc.append((os.path.basename(arg.name), arg.name, arg.typ))
                 if isinstance(arg, EXE):
                     self.console = arg.console
+                    self.set_runpath |= arg.linux_single_process
                     for tocnm, fnm, typ in arg.toc:
                         if tocnm == os.path.basename(arg.name) + ".manifest":
                             self.toc.append((tocnm, fnm, typ))
@@ -718,6 +927,18 @@ class COLLECT(Target):
                     logger.warning("failed to copy flags of %s", fnm)
             if typ in ('EXTENSION', 'BINARY'):
                 os.chmod(tofnm, 0o755)
+                # The bootloader runs the app without LD_LIBRARY_PATH, so
+                # every binary has to find its dependencies by itself.
+                if self.set_runpath and \
+                        not dylib.linux_set_relative_runpath(tofnm, inm):
+                    raise SystemExit('Cannot set RUNPATH of %s. Build without '
+                                     'linux_single_process.' % tofnm)
+        # Let the bootloader's importers find the extension modules without
+        # searching sys.path.
+        if is_py3:
+            index = os.path.join(self.name, EXTENSION_INDEX)
+            if not write_extension_index(index, self.toc):
+                os.remove(index)
         logger.info("Building COLLECT %s completed successfully.",
                     self.tocbasename)
 
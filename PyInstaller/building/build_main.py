@@ -223,6 +223,8 @@ class Analysis(Target):
             with open_file(pyi_crypto_key_path, 'w', encoding='utf-8') as f:
                 f.write(text_type('# -*- coding: utf-8 -*-\n'
                                   'key = %r\n' % cipher.key))
+            # The bootloader decrypts the PYZ archives itself. The AES module
+            # is bundled for bootloaders built without AES support.
             logger.info('Adding dependencies on pyi_crypto.py module')
             self.hiddenimports.append(pyz_crypto.get_crypto_hiddenimports())
 
@@ -348,17 +350,19 @@ class Analysis(Target):
             self.graph = initialize_modgraph(
                 excludes=self.excludes, user_hook_dirs=self.hookspath)
 
-        # TODO Find a better place where to put 'base_library.zip' and when to created it.
-        # For Python 3 it is necessary to create file 'base_library.zip'
-        # containing core Python modules. In Python 3 some built-in modules
-        # are written in pure Python. base_library.zip is a way how to have
-        # those modules as "built-in".
+        # For Python 3 it is necessary to bundle core Python modules needed
+        # to initialize Python. In Python 3 some built-in modules are written
+        # in pure Python. They are written to a table of frozen modules
+        # which the bootloader passes to Python, a way how to have those
+        # modules as "built-in".
+        base_library = TOC()
         if not is_py2:
-            libzip_filename = os.path.join(CONF['workpath'], 'base_library.zip')
-            create_py3_base_library(libzip_filename, graph=self.graph)
-            # Bundle base_library.zip as data file.
-            # Data format of TOC item:   ('relative_path_in_dist_dir', 'absolute_path_on_disk', 'DATA')
-            self.datas.append((os.path.basename(libzip_filename), libzip_filename, 'DATA'))
+            base_library_filename = os.path.join(CONF['workpath'], 'base_library.dat')
+            create_py3_base_library(base_library_filename, graph=self.graph)
+            # The table is embedded in the executable in onefile and onedir
+            # mode, so it goes with the scripts.
+            # Data format of TOC item:   ('name_in_carchive', 'absolute_path_on_disk', 'PYFROZEN')
+            base_library.append(('base_library', base_library_filename, 'PYFROZEN'))
 
         # Expand sys.path of module graph.
         # The attribute is the set of paths to use for imports: sys.path,
@@ -549,7 +553,8 @@ class Analysis(Target):
         ### Extract the nodes of the graph as TOCs for further processing.
 
         # Initialize the scripts list with priority scripts in the proper order.
-        self.scripts = self.graph.nodes_to_toc(priority_scripts)
+        # The base library goes first: MERGE expects the main script last.
+        self.scripts = base_library + self.graph.nodes_to_toc(priority_scripts)
 
         # Extend the binaries list with all the Extensions modulegraph has found.
         self.binaries = self.graph.make_binaries_toc(self.binaries)
@@ -47,6 +47,7 @@ class TOC(list):
     EXTENSION   Python internal name.  Full path name in build.    Extension module.
     PYSOURCE    Python internal name.  Full path name in build.    Script.
     PYMODULE    Python internal name.  Full path name in build.    Pure Python module (including __init__ modules).
+    PYFROZEN    Runtime name.          Full path name in build.    Table of frozen modules (Python 3 base library).
     PYZ         Runtime name.          Full path name in build.    A .pyz archive (ZlibArchive data structure).
     PKG         Runtime name.          Full path name in build.    A .pkg archive (Carchive data structure).
     BINARY      Runtime name.          Full path name in build.    Shared library.
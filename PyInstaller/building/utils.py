@@ -12,8 +12,10 @@
 #--- functions for checking guts ---
 # NOTE: By GUTS it is meant intermediate files and data structures that
 # PyInstaller creates for bundling files and creating final executable.
+import ast
 import glob
 import hashlib
+import marshal
 import os
 import os.path
 import pkgutil
@@ -128,6 +130,30 @@ def add_suffix_to_extensions(toc):
         new_toc.append((inm, fnm, typ))
     return new_toc
 
+
+# File name of the extension module index in the application directory. Keep
+# in sync with EXTENSION_INDEX in ``pyimod03_importers``.
+EXTENSION_INDEX = 'pyi_extension_index.dat'
+
+
+def write_extension_index(filename, toc):
+    """
+    Write the index of the EXTENSION items in 'toc' to 'filename' and return
+    the number of modules in it.
+
+    The index is a marshalled dict mapping module names to the relative file
+    names given by add_suffix_to_extensions(). The bootloader's importers use
+    it to load extension modules without searching sys.path (Python 3 only).
+    """
+    index = {}
+    for inm, fnm, typ in toc:
+        # Extensions in eggs are loaded from the egg.
+        if typ == 'EXTENSION' and os.path.isfile(fnm):
+            index[inm] = add_suffix_to_extensions([(inm, fnm, typ)])[0][0]
+    with open(filename, 'wb') as fp:
+        marshal.dump(index, fp)
+    return len(index)
+
 def applyRedirects(manifest, redirects):
     """
     Apply the binding redirects specified by 'redirects' to the dependent assemblies
@@ -670,6 +696,139 @@ def strip_paths_in_code(co, new_filename=None):
                      co.co_freevars, co.co_cellvars)
 
 
+def _module_selected(modname, selection):
+    """
+    Return True if 'selection' is True or lists 'modname' or one of its
+    packages.
+    """
+    if selection is True:
+        return True
+    return any(modname == name or modname.startswith(name + '.')
+               for name in selection or ())
+
+
+class _StripTransformer(ast.NodeTransformer):
+    """
+    Remove docstrings and/or replace assert statements with ``pass``.
+    """
+    def __init__(self, docstrings, asserts):
+        self.docstrings = docstrings
+        self.asserts = asserts
+
+    def _strip_docstring(self, node):
+        self.generic_visit(node)
+        if self.docstrings and node.body and _is_docstring(node.body[0]):
+            if len(node.body) > 1 and not _is_docstring(node.body[1]):
+                # Delete it, a ``pass`` would precede ``from __future__``
+                # imports.
+                del node.body[0]
+            else:
+                # Keep the body non-empty, and the next string no docstring.
+                node.body[0] = ast.copy_location(ast.Pass(), node.body[0])
+        return node
+
+    visit_Module = visit_ClassDef = visit_FunctionDef = \
+        visit_AsyncFunctionDef = _strip_docstring
+
+    def visit_Assert(self, node):
+        if self.asserts:
+            return ast.copy_location(ast.Pass(), node)
+        return node
+
+
+def _is_docstring(stmt):
+    if not isinstance(stmt, ast.Expr):
+        return False
+    if hasattr(ast, 'Constant') and isinstance(stmt.value, ast.Constant):
+        return isinstance(stmt.value.value, str)
+    return isinstance(stmt.value, ast.Str)
+
+
+def _replace_code(co, consts, lnotab=None):
+    """
+    Return a copy of the code object 'co' with other co_consts and, unless
+    None, line number table.
+    """
+    if hasattr(co, 'replace'):
+        # Python 3.8+
+        if lnotab is None:
+            return co.replace(co_consts=consts)
+        return co.replace(co_consts=consts, co_lnotab=lnotab)
+    if lnotab is None:
+        lnotab = co.co_lnotab
+    code_func = type(co)
+    if hasattr(co, 'co_kwonlyargcount'):
+        return code_func(co.co_argcount, co.co_kwonlyargcount, co.co_nlocals, co.co_stacksize,
+                     co.co_flags, co.co_code, consts, co.co_names,
+                     co.co_varnames, co.co_filename, co.co_name,
+                     co.co_firstlineno, lnotab,
+                     co.co_freevars, co.co_cellvars)
+    return code_func(co.co_argcount, co.co_nlocals, co.co_stacksize,
+                     co.co_flags, co.co_code, consts, co.co_names,
+                     co.co_varnames, co.co_filename, co.co_name,
+                     co.co_firstlineno, lnotab,
+                     co.co_freevars, co.co_cellvars)
+
+
+def _slim_code_object(co, strip_line_numbers, merged):
+    code_func = type(co)
+    consts = []
+    for const in co.co_consts:
+        if isinstance(const, code_func):
+            const = _slim_code_object(const, strip_line_numbers, merged)
+        elif merged is not None and type(const) in (str, bytes, type(u'')):
+            # Equal strings become one object, which marshal writes once
+            # and refers to afterwards.
+            const = merged.setdefault((type(const), const), const)
+        consts.append(const)
+    return _replace_code(co, tuple(consts), b'' if strip_line_numbers else None)
+
+
+def slim_code(modname, filename, co, strip_docstrings=False,
+              strip_asserts=False, strip_line_numbers=False,
+              merge_constants=False):
+    """
+    Return the code object 'co' of module 'modname' slimmed for the PYZ
+    archive. Each option is True for all modules or a list of names of
+    modules and packages it applies to.
+
+    strip_docstrings
+            Remove docstrings, as with ``python -OO``.
+    strip_asserts
+            Remove assert statements, as with ``python -O``.
+    strip_line_numbers
+            Remove the line number tables (up to Python 3.9). Tracebacks
+            then show the first line of each function only.
+    merge_constants
+            Store equal string and bytes constants of the module once (up
+            to Python 3.7).
+
+    Docstrings and asserts are removed by compiling the source file
+    'filename' again, modules without source are left unchanged.
+    """
+    docstrings = _module_selected(modname, strip_docstrings)
+    asserts = _module_selected(modname, strip_asserts)
+    if docstrings or asserts:
+        if filename and filename.endswith('.py') and os.path.isfile(filename):
+            with open(filename, 'rb') as fp:
+                tree = ast.parse(fp.read(), filename)
+            tree = _StripTransformer(docstrings, asserts).visit(tree)
+            co = compile(tree, filename, 'exec', dont_inherit=True)
+        else:
+            logger.debug('No source to strip docstrings and asserts from %s',
+                         modname)
+    # Since Python 3.10 the line table also maps the exceptions and
+    # positions, and the interpreter relies on it.
+    line_numbers = (_module_selected(modname, strip_line_numbers) and
+                    not hasattr(co, 'co_linetable'))
+    # Since Python 3.8 the compiler merges the constants of a module itself.
+    merge = (_module_selected(modname, merge_constants) and
+             sys.version_info < (3, 8))
+    if line_numbers or merge:
+        co = _slim_code_object(co, line_numbers, {} if merge else None)
+    return co
+
+
 def fake_pyc_timestamp(buf):
     """
     Reset the timestamp from a .pyc-file header to a fixed value.
@@ -796,7 +796,7 @@ else:
     del FileNotFoundError_
 
 
-# Patterns of module names that should be bundled into the base_library.zip.
+# Patterns of module names that should be bundled into the frozen base library.
 
 PY3_BASE_MODULES = {
     # Python 3.x
@@ -206,7 +206,7 @@ class PyiModuleGraph(ModuleGraph):
                 raise SystemExit(1)
             # Create references from top_script to current modules in graph.
             # These modules without parents are dependencies that are necessary
-            # for base_library.zip.
+            # for the frozen base library.
             for node in nodes_without_parent:
                 self.createReference(self._top_script_node, node)
             # Return top-level script node.
@@ -349,7 +349,7 @@ class PyiModuleGraph(ModuleGraph):
         scan all the nodes. This is patterned after ModuleGraph.report().
         """
         # Construct regular expression for matching modules that should be
-        # excluded because they are bundled in base_library.zip.
+        # excluded because they are bundled in the frozen base library.
         #
         # This expression matches the base module name, optionally followed by
         # a period and then any number of characters. This matches the module name and
@@ -364,7 +364,7 @@ class PyiModuleGraph(ModuleGraph):
             # would that even occur? After all, even "None" has a type! (It's
             # "NoneType", for the curious.) Remove this, please.
 
-            # Skip modules that are in base_library.zip.
+            # Skip modules that are in the frozen base library.
             if not is_py2 and module_filter.match(node.identifier):
                 continue
 
@@ -567,11 +567,11 @@ class PyiModuleGraph(ModuleGraph):
 def initialize_modgraph(excludes=(), user_hook_dirs=None):
     """
     Create the module graph and, for Python 3, analyze dependencies for
-    `base_library.zip` (which remain the same for every executable).
+    the frozen base library (which remain the same for every executable).
 
     This function might appear weird but is necessary for speeding up
     test runtime because it allows caching basic ModuleGraph object that
-    gets created for 'base_library.zip'.
+    gets created for the frozen base library.
 
     Parameters
     ----------
@@ -600,9 +600,9 @@ def initialize_modgraph(excludes=(), user_hook_dirs=None):
     )
 
     if not is_py2:
-        logger.info('Analyzing base_library.zip ...')
+        logger.info('Analyzing base library ...')
         required_mods = []
-        # Collect submodules from required modules in base_library.zip.
+        # Collect submodules from required modules in the base library.
         for m in PY3_BASE_MODULES:
             if is_package(m):
                 required_mods += collect_submodules(m)
@@ -24,6 +24,7 @@ import os
 import re
 
 
+from PyInstaller import compat
 from PyInstaller.compat import is_win, is_unix, is_aix, is_darwin
 
 
@@ -319,3 +320,49 @@ def mac_set_relative_dylib_deps(libname, distname):
             f.flush()
     except Exception:
         pass
+
+
+def linux_set_relative_runpath(libname, distname):
+    """
+    On Linux set the RUNPATH of the ELF binary `libname` to the top of the
+    dist directory, relative to '$ORIGIN', using 'patchelf'.
+
+    With this the dynamic linker finds the collected shared libraries without
+    LD_LIBRARY_PATH, so the bootloader can run a onedir application in a
+    single process. Existing RUNPATH entries relative to '$ORIGIN' (e.g. from
+    auditwheel) are kept, absolute ones of the build system are dropped.
+
+    'distname'  path of the library relative to dist directory of frozen
+                executable, see mac_set_relative_dylib_deps().
+
+    Returns False if `libname` is an ELF binary whose RUNPATH could not be
+    set, True otherwise.
+    """
+    if os.path.basename(libname) in _BOOTLOADER_FNAMES:
+        return True
+
+    with open(libname, 'rb') as f:
+        if f.read(4) != b'\x7fELF':
+            return True
+
+    runpath = ['$ORIGIN']
+    # Check if distname is not only base filename.
+    if os.path.dirname(distname):
+        parent_level = len(os.path.dirname(distname).split(os.sep))
+        runpath = ['/'.join(['$ORIGIN'] + parent_level * [os.pardir])]
+
+    retcode, out, err = compat.exec_command_all('patchelf', '--print-rpath',
+                                                libname)
+    if retcode != 0:
+        logger.debug('patchelf failed on %s: %s', libname, err.strip())
+        return False
+    for path in out.strip().split(':'):
+        if path.startswith('$ORIGIN') and path not in runpath:
+            runpath.append(path)
+
+    retcode, out, err = compat.exec_command_all(
+        'patchelf', '--set-rpath', ':'.join(runpath), libname)
+    if retcode != 0:
+        logger.debug('patchelf failed on %s: %s', libname, err.strip())
+        return False
+    return True
@@ -16,18 +16,16 @@ Utility functions related to analyzing/bundling dependencies.
 import ctypes
 import ctypes.util
 import dis
-import io
 import marshal
 import os
 import re
 import struct
-import zipfile
 
 from ..lib.modulegraph import util, modulegraph
 
 from .. import compat
-from ..compat import (is_darwin, is_unix, is_freebsd, is_py2, is_py37,
-                      BYTECODE_MAGIC, PY3_BASE_MODULES,
+from ..compat import (is_darwin, is_unix, is_freebsd, is_py2,
+                      PY3_BASE_MODULES,
                       exec_python_rc)
 from .dylib import include_library
 from .. import log as logging
@@ -35,15 +33,15 @@ from .. import log as logging
 logger = logging.getLogger(__name__)
 
 
-# TODO find out if modules from base_library.zip could be somehow bundled into the .exe file.
-def create_py3_base_library(libzip_filename, graph):
+def create_py3_base_library(filename, graph):
     """
-    Package basic Python modules into .zip file. The .zip file with basic
-    modules is necessary to have on PYTHONPATH for initializing libpython3
-    in order to run the frozen executable with Python 3.
+    Write basic Python modules into a table of frozen modules. These modules
+    are necessary to initialize libpython3 in order to run the frozen
+    executable with Python 3. The bootloader hands them to Python as frozen
+    modules, see write_frozen_modules().
     """
     # Construct regular expression for matching modules that should be bundled
-    # into base_library.zip.
+    # into the base library.
     # Excluded are plain 'modules' or 'submodules.ANY_NAME'.
     # The match has to be exact - start and end of string not substring.
     regex_modules = '|'.join([r'(^%s$)' % x for x in PY3_BASE_MODULES])
@@ -52,47 +50,48 @@ def create_py3_base_library(libzip_filename, graph):
     module_filter = re.compile(regex_str)
 
     try:
-        # Remove .zip from previous run.
-        if os.path.exists(libzip_filename):
-            os.remove(libzip_filename)
-        logger.debug('Adding python files to base_library.zip')
-        # Class zipfile.PyZipFile is not suitable for PyInstaller needs.
-        with zipfile.ZipFile(libzip_filename, mode='w') as zf:
-            zf.debug = 3
-            for mod in graph.flatten():
-                if type(mod) in (modulegraph.SourceModule, modulegraph.Package):
-                    # Bundling just required modules.
-                    if module_filter.match(mod.identifier):
-                        st = os.stat(mod.filename)
-                        timestamp = int(st.st_mtime)
-                        size = st.st_size & 0xFFFFFFFF
-                        # Name inside a zip archive.
-                        # TODO use .pyo suffix if optimize flag is enabled.
-                        if type(mod) is modulegraph.Package:
-                            new_name = mod.identifier.replace('.', os.sep) + os.sep + '__init__' + '.pyc'
-                        else:
-                            new_name = mod.identifier.replace('.', os.sep) + '.pyc'
-
-                        # Write code to a file.
-                        # This code is similar to py_compile.compile().
-                        with io.BytesIO() as fc:
-                            # Prepare all data in byte stream file-like object.
-                            fc.write(BYTECODE_MAGIC)
-                            if is_py37:
-                                # Additional bitfield according to PEP 552
-                                # zero means timestamp based
-                                fc.write(struct.pack('<I', 0))
-                            fc.write(struct.pack('<II', timestamp, size))
-                            marshal.dump(mod.code, fc)
-                            # Use a ZipInfo to set timestamp for deterministic build
-                            info = zipfile.ZipInfo(new_name)
-                            zf.writestr(info, fc.getvalue())
+        logger.debug('Adding python modules to the base library')
+        modules = []
+        for mod in graph.flatten():
+            if type(mod) in (modulegraph.SourceModule, modulegraph.Package):
+                # Bundling just required modules.
+                if module_filter.match(mod.identifier):
+                    modules.append((mod.identifier,
+                                    type(mod) is modulegraph.Package,
+                                    mod.code))
+        write_frozen_modules(filename, modules)
 
     except Exception as e:
-        logger.error('base_library.zip could not be created!')
+        logger.error('The base library could not be created!')
         raise
 
 
+def write_frozen_modules(filename, modules):
+    """
+    Write a table of frozen modules for the bootloader. It is stored as one
+    CArchive entry (typecode 'f') and passed to Python before initialization
+    as PyImport_FrozenModules, so that the modules are imported from memory
+    by Python's FrozenImporter.
+
+    MODULES is a list of (name, is_package, code) tuples. The format is a
+    big-endian uint32 with the number of modules, followed by one record per
+    module:
+
+        uint32  length of the marshalled code
+        uint8   1 for packages, else 0
+        char[]  module name, ASCII, terminated by NUL
+        bytes   marshalled code object
+    """
+    with open(filename, 'wb') as fp:
+        fp.write(struct.pack('!I', len(modules)))
+        # Sorted for reproducible builds.
+        for name, is_package, code in sorted(modules, key=lambda m: m[0]):
+            data = marshal.dumps(code)
+            fp.write(struct.pack('!IB', len(data), 1 if is_package else 0))
+            fp.write(name.encode('ascii') + b'\0')
+            fp.write(data)
+
+
 def scan_code_for_ctypes(co):
     binaries = []
 
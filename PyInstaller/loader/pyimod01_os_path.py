@@ -37,11 +37,13 @@ _mindirlen = 0
 if 'posix' in _builtin_names:  # For Linux, Unix, Mac OS X
     from posix import environ as os_environ
     from posix import listdir as os_listdir
+    from posix import stat as os_stat
     os_sep = '/'
     _mindirlen = 1
 elif 'nt' in _builtin_names:  # For Windows
     from nt import environ as os_environ
     from nt import listdir as os_listdir
+    from nt import stat as os_stat
     os_sep = '\\'
     _mindirlen = 3
 else:
@@ -58,6 +60,15 @@ def os_path_join(a, b, sep=os_sep):
     return a + sep + b
 
 
+# Wrap os.path.exists()
+def os_path_exists(path):
+    try:
+        os_stat(path)
+    except OSError:
+        return False
+    return True
+
+
 # Wrap os.path.dirname()
 def os_path_dirname(a, sep=os_sep, mindirlen=_mindirlen):
     for i in range(len(a) - 1, -1, -1):
@@ -24,6 +24,7 @@
 ### **NOTE** This module is used during bootstrap.
 ### Import *ONLY* builtin modules.
 
+import _io
 import marshal
 import struct
 import sys
@@ -32,16 +33,32 @@ if sys.version_info[0] == 2:
     import thread
 else:
     import _thread as thread
+# Positional reads, where available (POSIX, Python 3).
+try:
+    from posix import pread as _pread, open as _os_open, close as _os_close, \
+        O_RDONLY
+except ImportError:
+    _pread = None
 
 
 # For decrypting Python modules.
 CRYPT_BLOCK_SIZE = 16
+# Cipher modes of PYZ archives, in the header. Archives written by older
+# versions use CFB with 8-bit segments, the PyCrypto default.
+PYZ_CIPHER_NONE = 0
+PYZ_CIPHER_CFB8 = 1
+PYZ_CIPHER_CFB128 = 2
+# Flags of PYZ archives, in the header.
+# All entries are stored without compression.
+PYZ_FLAG_UNCOMPRESSED = 1
 
 
 # content types for PYZ
 PYZ_TYPE_MODULE = 0
 PYZ_TYPE_PKG = 1
 PYZ_TYPE_DATA = 2
+# Data entry stored without compression.
+PYZ_TYPE_DATA_STORED = 3
 
 class FilePos(object):
     """
@@ -65,6 +82,9 @@ class ArchiveFile(object):
         self.args = args
         self.kwargs = kwargs
         self._filePos = {}
+        # File descriptor for pread(), opened on first use.
+        self._fd = None
+        self._fd_lock = thread.allocate_lock()
 
     def local(self):
         """
@@ -110,6 +130,35 @@ class ArchiveFile(object):
         fp.file.close()
         fp.file = None
 
+    def pread(self, pos, length):
+        """
+        Return 'length' bytes at 'pos', or less at the end of the file.
+
+        With pread() the file stays open and no file position is involved, so
+        concurrent readers neither open the file for each read nor wait for
+        each other. Elsewhere the file is opened for the current thread.
+        """
+        if _pread is None:
+            with self:
+                self.seek(pos)
+                return self.read(length)
+        if self._fd is None:
+            with self._fd_lock:
+                if self._fd is None:
+                    self._fd = _os_open(self.args[0], O_RDONLY)
+        data = _pread(self._fd, length, pos)
+        while len(data) < length:
+            # Short read, e.g. interrupted by a signal.
+            chunk = _pread(self._fd, length - len(data), pos + len(data))
+            if not chunk:
+                break
+            data += chunk
+        return data
+
+    def __del__(self):
+        if self._fd is not None:
+            _os_close(self._fd)
+
 
 class ArchiveReadError(RuntimeError):
     pass
@@ -245,7 +294,7 @@ class Cipher(object):
     """
     This class is used only to decrypt Python modules.
     """
-    def __init__(self):
+    def __init__(self, segment_size=8):
         # At build-type the key is given to us from inside the spec file, at
         # bootstrap-time, we must look for it ourselves by trying to import
         # the generated 'pyi_crypto_key' module.
@@ -259,8 +308,16 @@ class Cipher(object):
             self.key = key.zfill(CRYPT_BLOCK_SIZE)
         assert len(self.key) == CRYPT_BLOCK_SIZE
 
-        # Import the right AES module.
-        self._aes = self._import_aesmod()
+        # The bootloader decrypts 128-bit segments natively, see pyi_aes.c.
+        # The AES module is only needed for other bootloaders and old archives.
+        self.segment_size = segment_size
+        self._native = None
+        if segment_size == 128:
+            self._native = getattr(sys, '_pyi_aes_cfb128_decrypt', None)
+        if self._native is None:
+            self._aes = self._import_aesmod()
+        else:
+            self._native_key = self.key.encode()
 
     def _import_aesmod(self):
         """
@@ -305,12 +362,118 @@ class Cipher(object):
         # The 'BlockAlgo' class is stateful, this factory method is used to
         # re-initialize the block cipher class with each call to encrypt() and
         # decrypt().
-        return self._aes.new(self.key, self._aes.MODE_CFB, iv)
+        return self._aes.new(self.key, self._aes.MODE_CFB, iv,
+                             segment_size=self.segment_size)
 
     def decrypt(self, data):
+        if self._native is not None:
+            return self._native(self._native_key, data)
         return self.__create_cipher(data[:CRYPT_BLOCK_SIZE]).decrypt(data[CRYPT_BLOCK_SIZE:])
 
 
+class ArchiveEntryStream(_io._RawIOBase):
+    """
+    Raw binary stream over the stored bytes of an archive entry at 'pos' in
+    the file 'path'. The bytes are read in chunks and, if 'compressed',
+    decompressed on the fly, so the whole entry is never held in memory.
+    Seeking backwards in compressed data restarts the decompression.
+
+    The stream has its own file object: it may outlive the import and be
+    read from any thread.
+    """
+    CHUNK_SIZE = 64 * 1024
+
+    def __init__(self, path, pos, length, compressed=True, zdict=None):
+        super(ArchiveEntryStream, self).__init__()
+        self._file = open(path, 'rb')
+        self._start = pos
+        self._length = length
+        self._compressed = compressed
+        self._zdict = zdict
+        self._rewind()
+
+    def _rewind(self):
+        # Position in the entry data and in the stored bytes.
+        self._pos = 0
+        self._stored_pos = 0
+        # Decompressed bytes not returned yet.
+        self._pending = b''
+        if self._compressed:
+            if self._zdict:
+                self._decompressor = zlib.decompressobj(zdict=self._zdict)
+            else:
+                self._decompressor = zlib.decompressobj()
+
+    def readable(self):
+        return True
+
+    def seekable(self):
+        return True
+
+    def tell(self):
+        return self._pos
+
+    def readinto(self, b):
+        view = memoryview(b)
+        if not self._compressed:
+            # Read straight into the caller's buffer.
+            size = min(len(view), self._length - self._pos)
+            if size <= 0:
+                return 0
+            self._file.seek(self._start + self._pos)
+            size = self._file.readinto(view[:size])
+            self._pos += size
+            return size
+        while not self._pending:
+            data = self._decompressor.unconsumed_tail
+            if not data:
+                size = min(self.CHUNK_SIZE, self._length - self._stored_pos)
+                if size <= 0:
+                    return 0
+                self._file.seek(self._start + self._stored_pos)
+                data = self._file.read(size)
+                self._stored_pos += size
+            self._pending = self._decompressor.decompress(
+                data, max(len(view), self.CHUNK_SIZE))
+        size = min(len(view), len(self._pending))
+        view[:size] = self._pending[:size]
+        self._pending = self._pending[size:]
+        self._pos += size
+        return size
+
+    def seek(self, offset, whence=0):
+        if whence == 1:
+            offset += self._pos
+        elif whence == 2:
+            if self._compressed:
+                # The size is known only after decompressing everything.
+                buf = bytearray(self.CHUNK_SIZE)
+                while self.readinto(buf):
+                    pass
+                offset += self._pos
+            else:
+                offset += self._length
+        if offset < 0:
+            raise ValueError('negative seek position %d' % offset)
+        if not self._compressed:
+            self._pos = offset
+            return offset
+        if offset < self._pos:
+            self._rewind()
+        buf = bytearray(self.CHUNK_SIZE)
+        while self._pos < offset:
+            if not self.readinto(memoryview(buf)[:offset - self._pos]):
+                break
+        return self._pos
+
+    def close(self):
+        # Also called on garbage collection, maybe after a failed open().
+        file = getattr(self, '_file', None)
+        if file is not None:
+            file.close()
+        super(ArchiveEntryStream, self).close()
+
+
 class ZlibArchiveReader(ArchiveReader):
     """
     ZlibArchive - an archive with compressed entries. Archive is read
@@ -320,10 +483,17 @@ class ZlibArchiveReader(ArchiveReader):
 
     NOTE: The whole ZlibArchive (PYZ) is compressed so it is not necessary
           to compress single modules with zlib.
+
+    The entries of an archive with the flag PYZ_FLAG_UNCOMPRESSED are read
+    from a read-only mapping of the file (Python 3). Code is unmarshalled
+    straight from the mapping, so all processes running the application
+    share one copy of the archive in the page cache.
     """
     MAGIC = b'PYZ\0'
     TOCPOS = 8
-    HDRLEN = ArchiveReader.HDRLEN + 5
+    HDRLEN = ArchiveReader.HDRLEN + 6
+    # Number of decompressed blocks kept for the next entries.
+    BLOCK_CACHE_SIZE = 4
 
     def __init__(self, path=None, offset=None):
         if path is None:
@@ -344,33 +514,158 @@ class ZlibArchiveReader(ArchiveReader):
 
         super(ZlibArchiveReader, self).__init__(path, offset)
 
-        # Try to import the key module. If the key module is not available
-        # then it means that encryption is disabled.
+        self.cipher = None
+        self.zdict = None
+        self.compressed = True
+        if path is not None:
+            (flags,) = struct.unpack('!B', self.lib.pread(
+                self.start + self.HDRLEN - 6, 1))
+            self.compressed = not flags & PYZ_FLAG_UNCOMPRESSED
+            self.cipher = self.loadcipher()
+            self.loadzdict()
+        # Read-only mapping of an uncompressed archive, see _read().
+        self._view = None
+        # Recently decompressed blocks as (pos, data), most recent first.
+        self._blocks = []
+
+    def loadcipher(self):
+        """
+        Return the Cipher decrypting the entries, or None if the entries are
+        not encrypted or the key module is not available. The header byte
+        before the length of the preset dictionary gives the cipher mode.
+        """
+        (mode,) = struct.unpack('!B', self.lib.pread(
+            self.start + self.HDRLEN - 5, 1))
+        if mode == PYZ_CIPHER_NONE:
+            return None
         try:
             import pyimod00_crypto_key
-            self.cipher = Cipher()
         except ImportError:
-            self.cipher = None
+            return None
+        return Cipher(128 if mode == PYZ_CIPHER_CFB128 else 8)
+
+    def loadzdict(self):
+        """
+        Load the preset dictionary the entries are compressed with. The last
+        four bytes of the header give the length of its stored form, which
+        follows the header.
+        """
+        (length,) = struct.unpack('!I', self.lib.pread(
+            self.start + self.HDRLEN - 4, 4))
+        if length:
+            obj = self.lib.pread(self.start + self.HDRLEN, length)
+            if self.cipher:
+                obj = self.cipher.decrypt(obj)
+            self.zdict = zlib.decompress(obj)
 
     def is_package(self, name):
-        (typ, pos, length) = self.toc.get(name, (0, None, 0))
-        if pos is None:
+        entry = self.toc.get(name)
+        if entry is None:
             return None
-        return typ == PYZ_TYPE_PKG
+        return entry[0] == PYZ_TYPE_PKG
 
-    def extract(self, name):
-        (typ, pos, length) = self.toc.get(name, (0, None, 0))
-        if pos is None:
-            return None
-        with self.lib:
-            self.lib.seek(self.start + pos)
-            obj = self.lib.read(length)
+    def _read(self, pos, length):
+        """
+        Return the data stored at pos, as a memoryview of the mapped file if
+        the archive is uncompressed and not encrypted.
+        """
+        if self.compressed or self.cipher or sys.version_info[0] == 2:
+            return self.lib.pread(self.start + pos, length)
+        view = self._view
+        if view is None:
+            view = self._view = self._map()
+        if view is False:
+            return self.lib.pread(self.start + pos, length)
+        return view[self.start + pos:self.start + pos + length]
+
+    def _map(self):
+        """
+        Map the whole file read-only, or return False if it cannot be mapped.
+        This is done on the first read of an entry, when the 'mmap' extension
+        can be imported. Concurrent first reads may map the file twice.
+        """
         try:
+            import mmap
+            with _io.open(self.path, 'rb') as file:
+                return memoryview(mmap.mmap(file.fileno(), 0,
+                                            access=mmap.ACCESS_READ))
+        except (ImportError, EnvironmentError, ValueError):
+            return False
+
+    def _decompress(self, pos, length):
+        """
+        Read, decrypt and decompress the data stored at pos.
+        """
+        obj = self._read(pos, length)
+        if self.cipher:
+            obj = self.cipher.decrypt(obj)
+        if not self.compressed:
+            return obj
+        if self.zdict:
+            return zlib.decompressobj(zdict=self.zdict).decompress(obj)
+        return zlib.decompress(obj)
+
+    def _block(self, pos, length):
+        """
+        Return the decompressed block stored at pos. The last blocks are
+        cached, so the modules of a package are decompressed only once.
+        """
+        blocks = self._blocks
+        for block_pos, data in blocks:
+            if block_pos == pos:
+                break
+        else:
+            data = self._decompress(pos, length)
+        # Replace the list instead of changing it, for concurrent imports.
+        self._blocks = [(pos, data)] + [
+            block for block in blocks
+            if block[0] != pos][:self.BLOCK_CACHE_SIZE - 1]
+        return data
+
+    def _entry_data(self, entry):
+        """
+        Return the uncompressed data of the TOC record 'entry'.
+        """
+        typ, pos, length = entry[:3]
+        if len(entry) == 5:
+            offset, ulen = entry[3:]
+            return self._block(pos, length)[offset:offset + ulen]
+        if typ == PYZ_TYPE_DATA_STORED:
+            obj = self._read(pos, length)
             if self.cipher:
                 obj = self.cipher.decrypt(obj)
-            obj = zlib.decompress(obj)
+            return obj
+        return self._decompress(pos, length)
+
+    def open_entry(self, name):
+        """
+        Return a binary file object reading the data entry 'name', or None
+        if there is no such data entry. Entries stored on their own are
+        streamed from the archive, see ArchiveEntryStream.
+        """
+        entry = self.toc.get(name)
+        if entry is None or entry[0] not in (PYZ_TYPE_DATA,
+                                             PYZ_TYPE_DATA_STORED):
+            return None
+        if len(entry) == 5 or self.cipher:
+            # Blocks are cached, and the cipher decrypts whole entries only.
+            return _io.BytesIO(self._entry_data(entry))
+        typ, pos, length = entry
+        return _io.BufferedReader(ArchiveEntryStream(
+            self.path, self.start + pos, length,
+            compressed=typ == PYZ_TYPE_DATA, zdict=self.zdict))
+
+    def extract(self, name):
+        entry = self.toc.get(name)
+        if entry is None:
+            return None
+        typ = entry[0]
+        try:
+            obj = self._entry_data(entry)
             if typ in (PYZ_TYPE_MODULE, PYZ_TYPE_PKG):
                 obj = marshal.loads(obj)
+            elif isinstance(obj, memoryview):
+                obj = obj.tobytes()
         except EOFError:
             raise ImportError("PYZ entry '%s' failed to unmarshal" % name)
         return typ, obj
@@ -18,10 +18,13 @@ PEP-302 and PEP-451 importers for frozen applications.
 
 
 
+import _io
+import marshal
 import sys
 import pyimod01_os_path as pyi_os_path
 
-from pyimod02_archive import ArchiveReadError, ZlibArchiveReader
+from pyimod02_archive import ArchiveReadError, ZlibArchiveReader, \
+    PYZ_TYPE_DATA, PYZ_TYPE_DATA_STORED
 
 
 SYS_PREFIX = sys._MEIPASS
@@ -45,6 +48,7 @@ else:
     def imp_lock(): pass
     def imp_unlock(): pass
     import _frozen_importlib
+    import _thread
     if sys.version_info[1] <= 4:
         # Python 3.3, 3.4
         EXTENSION_SUFFIXES = _frozen_importlib.EXTENSION_SUFFIXES
@@ -216,6 +220,7 @@ class FrozenImporter(object):
                 # Some runtime hook might need access to the list of available
                 # frozen module. Let's make them accessible as a set().
                 self.toc = set(self._pyz_archive.toc.keys())
+                self._load_lazy_modules()
                 # Return - no error was raised.
                 trace("# PyInstaller: FrozenImporter(%s)", pyz_filepath)
                 return
@@ -232,6 +237,33 @@ class FrozenImporter(object):
         raise ImportError("Can't load frozen modules.")
 
 
+    def _load_lazy_modules(self):
+        """
+        Load the names of the modules to import lazily from the module
+        pyimod00_lazy_modules, written by PYZ(lazy_modules=...).
+        """
+        # Names of the lazy modules not run yet, mapped to [lock, running].
+        self._lazy_states = {}
+        try:
+            # Changing the class of a module requires Python 3.5.
+            if sys.version_info[0:2] < (3, 5):
+                raise ImportError('No lazy modules')
+            import pyimod00_lazy_modules
+        except ImportError:
+            self._lazy_modules = None
+            return
+        self._lazy_modules = pyimod00_lazy_modules.modules
+        self._lazy_excludes = pyimod00_lazy_modules.excludes
+
+    def _is_lazy(self, fullname):
+        def selected(names):
+            return names is True or any(
+                fullname == name or fullname.startswith(name + '.')
+                for name in names)
+        return (self._lazy_modules is not None and
+                selected(self._lazy_modules) and
+                not selected(self._lazy_excludes))
+
     def __call__(self, path):
         """
         PEP-302 sys.path_hook processor. is_py2: This is only needed for Python
@@ -604,7 +636,6 @@ class FrozenImporter(object):
         not support in-place reloading.
         """
         spec = module.__spec__
-        bytecode = self.get_code(spec.loader_state)
 
         # Set by the import machinery
         assert hasattr(module, '__file__')
@@ -624,7 +655,207 @@ class FrozenImporter(object):
             # Set __path__ to point to 'sys.prefix/package/subpackage'.
             module.__path__ = [pyi_os_path.os_path_dirname(module.__file__)]
 
-        exec(bytecode, module.__dict__)
+        if self._is_lazy(spec.name):
+            # Decompress and run the code on first attribute access.
+            self._lazy_states[spec.name] = [_thread.RLock(), False]
+            module.__class__ = _LazyModule
+            trace("# %s is lazy", spec.name)
+            return
+
+        exec(self.get_code(spec.loader_state), module.__dict__)
+
+    def _exec_lazy_module(self, module):
+        """
+        Run the code of the lazy module 'module' unless it already ran or is
+        running in this thread. Other threads wait until it finished.
+        """
+        spec = ModuleType.__getattribute__(module, '__spec__')
+        state = self._lazy_states.get(spec.name)
+        if state is None:
+            return
+        with state[0]:
+            if state[1] or self._lazy_states.get(spec.name) is not state:
+                return
+            state[1] = True
+            trace("# running lazy module %s", spec.name)
+            try:
+                exec(self.get_code(spec.loader_state), module.__dict__)
+            finally:
+                del self._lazy_states[spec.name]
+                module.__class__ = ModuleType
+
+    def get_resource_reader(self, fullname):
+        """
+        Return the importlib.resources reader of the package 'fullname'
+        (Python 3.7+), or None for a module.
+        """
+        if fullname in self.toc and self.is_package(fullname):
+            return FrozenResourceReader(self, fullname)
+        return None
+
+    def _resource_dirs(self):
+        """
+        Return a dict mapping each directory that holds PYZ data entries to
+        the set of names in it. Directories are given like the names of
+        the data entries, relative to sys._MEIPASS.
+        """
+        dirs = getattr(self, '_pyz_dirs', None)
+        if dirs is None:
+            dirs = {}
+            for name, entry in self._pyz_archive.toc.items():
+                if entry[0] not in (PYZ_TYPE_DATA, PYZ_TYPE_DATA_STORED):
+                    continue
+                parts = name.split(pyi_os_path.os_sep)
+                for i in range(len(parts)):
+                    dirs.setdefault(pyi_os_path.os_sep.join(parts[:i]),
+                                    set()).add(parts[i])
+            self._pyz_dirs = dirs
+        return dirs
+
+
+# File type bits of stat() results.
+_S_IFMT = 0o170000
+_S_IFDIR = 0o040000
+_S_IFREG = 0o100000
+
+
+# The module type; the 'types' module is not built-in.
+ModuleType = type(sys)
+
+
+class _LazyModule(ModuleType):
+    """
+    A module imported lazily by the FrozenImporter. Accessing an attribute
+    runs its code and turns it into a normal module.
+    """
+    def __getattribute__(self, attr):
+        # The import system reads __spec__ when the module is imported again.
+        if attr != '__spec__':
+            spec = ModuleType.__getattribute__(self, '__spec__')
+            spec.loader._exec_lazy_module(self)
+        return ModuleType.__getattribute__(self, attr)
+
+    def __delattr__(self, attr):
+        spec = ModuleType.__getattribute__(self, '__spec__')
+        spec.loader._exec_lazy_module(self)
+        ModuleType.__delattr__(self, attr)
+
+
+def _file_type(path):
+    try:
+        return pyi_os_path.os_stat(path).st_mode & _S_IFMT
+    except OSError:
+        return None
+
+
+class FrozenResourceReader(object):
+    """
+    importlib.resources reader of a package loaded by FrozenImporter.
+
+    The resources of the package 'a.b' are the data entries 'a/b/...' of the
+    PYZ archive and the files collected into sys._MEIPASS/a/b. Data entries
+    are opened as streams (see ZlibArchiveReader.open_entry()), so reading a
+    part of a resource does not read or decompress all of it.
+    """
+    def __init__(self, importer, fullname):
+        self._importer = importer
+        self._relpath = fullname.replace('.', pyi_os_path.os_sep)
+
+    def files(self):
+        """
+        Return the Traversable of the package directory (Python 3.9+).
+        """
+        return FrozenResource(self._importer, self._relpath)
+
+    def open_resource(self, resource):
+        return self.files().joinpath(resource).open('rb')
+
+    def resource_path(self, resource):
+        # Only files on disk have a path.
+        resource = self.files().joinpath(resource)
+        if isinstance(resource, FrozenResource):
+            raise FileNotFoundError(resource.name)
+        return str(resource)
+
+    def is_resource(self, name):
+        return self.files().joinpath(name).is_file()
+
+    def contents(self):
+        return [resource.name for resource in self.files().iterdir()]
+
+
+class FrozenResource(object):
+    """
+    importlib.resources Traversable for the path 'relpath' below
+    sys._MEIPASS where PYZ data entries are found. Paths with no PYZ data
+    entries are represented by pathlib.Path objects instead: then
+    importlib.resources.as_file() can return them without a copy. pathlib
+    is imported by importlib.resources anyway.
+    """
+    def __init__(self, importer, relpath):
+        self._importer = importer
+        self._relpath = relpath
+        self._path = pyi_os_path.os_path_join(SYS_PREFIX, relpath)
+        self.name = relpath.rsplit(pyi_os_path.os_sep, 1)[-1]
+
+    def __repr__(self):
+        return '<FrozenResource %r>' % self._path
+
+    def _in_pyz(self):
+        parent, _, name = self._relpath.rpartition(pyi_os_path.os_sep)
+        return name in self._importer._resource_dirs().get(parent, ())
+
+    def _child(self, relpath):
+        resource = FrozenResource(self._importer, relpath)
+        if resource._in_pyz():
+            return resource
+        import pathlib
+        return pathlib.Path(resource._path)
+
+    def iterdir(self):
+        names = set(self._importer._resource_dirs().get(self._relpath, ()))
+        if _file_type(self._path) == _S_IFDIR:
+            names.update(pyi_os_path.os_listdir(self._path))
+        for name in sorted(names):
+            yield self._child(
+                pyi_os_path.os_path_join(self._relpath, name))
+
+    def is_dir(self):
+        return (self._relpath in self._importer._resource_dirs() or
+                _file_type(self._path) == _S_IFDIR)
+
+    def is_file(self):
+        entry = self._importer._pyz_archive.toc.get(self._relpath)
+        if entry is not None:
+            return entry[0] in (PYZ_TYPE_DATA, PYZ_TYPE_DATA_STORED)
+        return _file_type(self._path) == _S_IFREG
+
+    def joinpath(self, *descendants):
+        relpath = self._relpath
+        for descendant in descendants:
+            for name in str(descendant).replace('/', pyi_os_path.os_sep).split(
+                    pyi_os_path.os_sep):
+                if name:
+                    relpath = pyi_os_path.os_path_join(relpath, name)
+        return self._child(relpath)
+
+    __truediv__ = joinpath
+
+    def open(self, mode='r', *args, **kwargs):
+        stream = self._importer._pyz_archive.open_entry(self._relpath)
+        if stream is None:
+            stream = open(self._path, 'rb')
+        if 'b' in mode:
+            return stream
+        return _io.TextIOWrapper(stream, *args, **kwargs)
+
+    def read_bytes(self):
+        with self.open('rb') as stream:
+            return stream.read()
+
+    def read_text(self, encoding=None, errors=None):
+        with self.open(encoding=encoding, errors=errors) as stream:
+            return stream.read()
 
 
 # is_py2: This is only needed for Python 2.
@@ -776,6 +1007,259 @@ class CExtensionImporter(object):
         raise ImportError('No module named ' + fullname)
 
 
+class FrozenBaseImporter(object):
+    """
+    PEP-451 finder wrapping the interpreter's FrozenImporter, which imports
+    the modules of the base library: the bootloader passes them to Python
+    as frozen modules.
+
+    Frozen modules have no __file__. Set __file__ and, for packages,
+    __path__ below sys._MEIPASS, as FrozenImporter does for the modules in
+    the PYZ archive. Loading is left to the interpreter's FrozenImporter.
+    """
+    # Frozen modules of the import system itself. The test modules of Python
+    # 3.11+ start with '__'.
+    _SKIP = ('_frozen_importlib', '_frozen_importlib_external', 'zipimport')
+
+    def __init__(self, importer):
+        self._importer = importer
+
+    @classmethod
+    def _set_location(cls, spec):
+        if spec.name in cls._SKIP or spec.name.startswith('__'):
+            return False
+        dirname = pyi_os_path.os_path_join(SYS_PREFIX,
+            spec.name.replace('.', pyi_os_path.os_sep))
+        if spec.submodule_search_locations is not None:
+            spec.origin = pyi_os_path.os_path_join(dirname, '__init__.pyc')
+            spec.submodule_search_locations = [dirname]
+        else:
+            spec.origin = dirname + '.pyc'
+        spec.has_location = True
+        # Python 3.11+ would set __file__ to a source file below
+        # sys._stdlib_dir, which does not exist.
+        if getattr(spec.loader_state, 'filename', None):
+            spec.loader_state.filename = None
+        return True
+
+    @classmethod
+    def fix_imported_modules(cls):
+        """
+        Set __file__ and __path__ of the frozen modules imported while Python
+        was initialized.
+        """
+        for module in list(sys.modules.values()):
+            spec = getattr(module, '__spec__', None)
+            if (spec is None or
+                    spec.loader is not _frozen_importlib.FrozenImporter or
+                    not cls._set_location(spec)):
+                continue
+            module.__file__ = spec.origin
+            if spec.submodule_search_locations is not None:
+                module.__path__ = list(spec.submodule_search_locations)
+
+    def find_spec(self, fullname, path=None, target=None):
+        spec = self._importer.find_spec(fullname, path, target)
+        if spec is not None:
+            self._set_location(spec)
+        return spec
+
+    def __getattr__(self, name):
+        # find_module() and the rest of the interface of the wrapped finder.
+        return getattr(self._importer, name)
+
+
+# Index of the C extension modules in sys._MEIPASS, written by the build. Keep
+# in sync with EXTENSION_INDEX in ``PyInstaller.building.utils``.
+EXTENSION_INDEX = 'pyi_extension_index.dat'
+
+
+class ExtensionIndexFinder(object):
+    """
+    PEP-451 finder for the C extension modules listed in EXTENSION_INDEX.
+
+    The PathFinder looks for an extension module with a stat() call for each
+    suffix in EXTENSION_SUFFIXES in each directory on sys.path (or the
+    __path__ of the package). The index maps the module names of the bundled
+    extensions to their files, so they are found without touching the
+    filesystem. Modules not in the index are left to the PathFinder.
+    """
+    def __init__(self, index=None):
+        self._path = pyi_os_path.os_path_join(SYS_PREFIX, EXTENSION_INDEX)
+        self._index = index
+
+    def _get_index(self):
+        if self._index is None:
+            try:
+                with _io.open(self._path, 'rb') as fp:
+                    self._index = marshal.load(fp)
+            except OSError:
+                # Not extracted yet in pipelined mode, the PathFinder finds
+                # the module meanwhile.
+                return {}
+        return self._index
+
+    @classmethod
+    def load(cls):
+        """
+        Return a finder for the index in sys._MEIPASS, or None if there is no
+        index.
+        """
+        finder = cls()
+        pending = getattr(_pending_extraction, '_pending_datas', ())
+        if finder._path in pending:
+            # Load the index on first use, once it is extracted.
+            return finder
+        if not finder._get_index():
+            return None
+        return finder
+
+    def find_spec(self, fullname, path=None, target=None):
+        filename = self._get_index().get(fullname)
+        if filename is None:
+            return None
+        filename = pyi_os_path.os_path_join(SYS_PREFIX, filename)
+        spec = _frozen_importlib.ModuleSpec(
+            fullname, EXTENSION_LOADER(fullname, filename), origin=filename)
+        spec.has_location = True
+        return spec
+
+    def invalidate_caches(self):
+        pass
+
+
+# Left in sys._MEIPASS by the bootloader when it failed to extract a deferred
+# file in pipelined mode.
+EXTRACTION_FAILED_MARKER = '.pyi-extraction-failed'
+
+
+class PendingExtraction(object):
+    """
+    Wait for files that the bootloader is still extracting.
+
+    With pipelined extraction (onefile, ``EXE(pipelined_extraction=True)``)
+    the bootloader starts the application as soon as the files needed to
+    start Python are extracted. Binaries inside packages and data files are
+    extracted by the parent process meanwhile; each of them is renamed into
+    place once complete.
+
+    The instance is put on sys.meta_path in front of the PathFinder: the first
+    import not served from the PYZ archive waits until all deferred files,
+    binaries and data files, are available. Before that, opening a pending
+    data file with open() waits for that file. Other access to the files
+    (os.stat(), os.listdir(), C code) does not wait, see
+    wait_for_extraction().
+    """
+    def __init__(self, binaries, datas):
+        from time import sleep
+        self._sleep = sleep
+        self._failed_marker = pyi_os_path.os_path_join(SYS_PREFIX,
+                                                       EXTRACTION_FAILED_MARKER)
+        # Paths in the order in which they are extracted.
+        self._binaries = [pyi_os_path.os_path_join(SYS_PREFIX, name)
+                          for name in binaries]
+        self._datas = [pyi_os_path.os_path_join(SYS_PREFIX, name)
+                       for name in datas]
+        self._pending_datas = set(self._datas)
+        self._builtin_open = None
+
+    def _wait(self, path):
+        delay = 0.0005
+        while not pyi_os_path.os_path_exists(path):
+            if pyi_os_path.os_path_exists(self._failed_marker):
+                raise OSError('Failed to extract ' + path)
+            self._sleep(delay)
+            delay = min(delay * 2, 0.05)
+
+    def install(self, index):
+        if self._binaries and pyi_os_path.os_path_exists(self._binaries[-1]):
+            self._binaries = []
+        if self._datas and not pyi_os_path.os_path_exists(self._datas[-1]):
+            import builtins
+            self._builtin_open = builtins.open
+            builtins.open = self._open
+            if getattr(sys.modules.get('io'), 'open', None) is self._builtin_open:
+                sys.modules['io'].open = self._open
+        else:
+            self._datas = []
+            self._pending_datas.clear()
+        if self._binaries or self._datas:
+            sys.meta_path.insert(index, self)
+
+    def _uninstall_open(self):
+        import builtins
+        if builtins.open == self._open:
+            builtins.open = self._builtin_open
+        if getattr(sys.modules.get('io'), 'open', None) == self._open:
+            sys.modules['io'].open = self._builtin_open
+        self._datas = []
+        self._pending_datas.clear()
+
+    def wait_all(self):
+        if not self._binaries and not self._datas:
+            return
+        trace('# waiting for extraction of binaries and data files')
+        if self._binaries:
+            self._wait(self._binaries[-1])
+            self._binaries = []
+        if self._datas:
+            self._wait(self._datas[-1])
+            self._uninstall_open()
+        if self in sys.meta_path:
+            sys.meta_path.remove(self)
+        # Directory listings cached by the PathFinder may predate the files.
+        for finder in list(sys.path_importer_cache.values()):
+            if hasattr(finder, 'invalidate_caches'):
+                finder.invalidate_caches()
+
+    def wait(self, path):
+        """
+        Wait until all pending files equal to or below 'path' are extracted.
+        """
+        prefix = path.rstrip(pyi_os_path.os_sep) + pyi_os_path.os_sep
+        last = None
+        for name in self._binaries + self._datas:
+            if name == path or name.startswith(prefix):
+                last = name
+        if last is not None:
+            self._wait(last)
+            if self._datas and last == self._datas[-1]:
+                self._uninstall_open()
+
+    def find_spec(self, fullname, path=None, target=None):
+        # Modules and packages may be data files too, and finders of
+        # distribution metadata list directories.
+        try:
+            self.wait_all()
+        except OSError as e:
+            raise ImportError(str(e), name=fullname)
+        return None
+
+    def _open(self, file, *args, **kwargs):
+        if self._pending_datas:
+            fspath = getattr(file, '__fspath__', None)
+            path = fspath() if fspath else file
+            if path in self._pending_datas:
+                self._wait(path)
+                self._pending_datas.discard(path)
+                if pyi_os_path.os_path_exists(self._datas[-1]):
+                    self._uninstall_open()
+        return self._builtin_open(file, *args, **kwargs)
+
+
+# PendingExtraction instance when the bootloader is still extracting files.
+_pending_extraction = None
+
+
+def wait_for_extraction(path):
+    """
+    Wait until files at or below 'path' are extracted. Returns immediately
+    unless pipelined extraction is in progress.
+    """
+    if _pending_extraction is not None:
+        _pending_extraction.wait(path)
+
+
 def install():
     """
     Install FrozenImporter class and other classes into the import machinery.
@@ -829,6 +1313,12 @@ def install():
             if hasattr(item, '__name__') and item.__name__ == 'WindowsRegistryFinder':
                 sys.meta_path.remove(item)
                 break
+        # Give the frozen modules of the base library a __file__.
+        for i, item in enumerate(sys.meta_path):
+            if item is _frozen_importlib.FrozenImporter:
+                sys.meta_path[i] = FrozenBaseImporter(item)
+                FrozenBaseImporter.fix_imported_modules()
+                break
         # _frozen_importlib.PathFinder is also able to handle Python C
         # extensions. However, PyInstaller needs its own importer since it
         # uses extension names like 'module.submodle.so' (instead of paths).
@@ -843,4 +1333,16 @@ def install():
                 if not item in pathFinders:
                     pathFinders.append(item)
         sys.meta_path.extend(reversed(pathFinders))
+
+        # Files may still be extracted by the bootloader (pipelined mode).
+        pending = getattr(sys, '_pyi_pending_extraction', None)
+        if pending:
+            global _pending_extraction
+            _pending_extraction = PendingExtraction(*pending)
+            _pending_extraction.install(len(sys.meta_path) - len(pathFinders))
+        # Find the bundled C extension modules without searching sys.path.
+        extension_finder = ExtensionIndexFinder.load()
+        if extension_finder is not None:
+            sys.meta_path.insert(len(sys.meta_path) - len(pathFinders),
+                                 extension_finder)
         # TODO Do we need for Python 3 _frozen_importlib.FrozenImporter? Could it be also removed?
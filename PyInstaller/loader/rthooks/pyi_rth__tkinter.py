@@ -24,6 +24,12 @@ except NameError:
 tcldir = os.path.join(sys._MEIPASS, 'tcl')
 tkdir = os.path.join(sys._MEIPASS, 'tk')
 
+# Tcl/Tk read these files from C code, wait if they are still extracted.
+if hasattr(sys, '_pyi_pending_extraction'):
+    import pyimod03_importers
+    pyimod03_importers.wait_for_extraction(tcldir)
+    pyimod03_importers.wait_for_extraction(tkdir)
+
 if not os.path.isdir(tcldir):
     raise FileNotFoundError('Tcl data directory "%s" not found.' % (tcldir))
 if not os.path.isdir(tkdir):
@@ -0,0 +1,390 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * AES decryption of encrypted PYZ archives.
+ *
+ * With --key the PYZ entries are encrypted with AES-128 in CFB mode. Doing
+ * the decryption here means the bootstrap code does not have to load the
+ * PyCrypto extension before it can import anything from the PYZ archive.
+ *
+ * CFB decryption only uses the forward cipher, and as the whole ciphertext
+ * is known, the blocks are independent of each other. On x86 processors with
+ * AES-NI and on ARMv8 with the crypto extension the blocks are encrypted
+ * with these instructions, several at a time. Elsewhere a portable
+ * implementation is used.
+ */
+
+#include <string.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_python.h"
+#include "pyi_aes.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>      /* __cpuid */
+    #include <wmmintrin.h>
+    #define AES_NI
+    #define AES_NI_TARGET
+#elif (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+    #include <wmmintrin.h>
+    #define AES_NI
+    #define AES_NI_TARGET  __attribute__((target("aes,sse2")))
+#elif defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+    #include <arm_neon.h>
+    #define AES_ARMV8
+#endif
+
+#define AES_ROUNDS  10
+
+/* Round keys of AES-128, in the byte order of FIPS-197. */
+typedef struct {
+    unsigned char rk[(AES_ROUNDS + 1) * PYI_AES_BLOCK_SIZE];
+} AES_KEY;
+
+static const unsigned char _sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+/* Multiplication by x in GF(2^8). */
+#define XTIME(b)  ((unsigned char) (((b) << 1) ^ (((b) & 0x80) ? 0x1b : 0)))
+
+static void
+_expand_key(AES_KEY *key, const unsigned char *user_key)
+{
+    unsigned char *rk = key->rk;
+    unsigned char rcon = 0x01;
+    unsigned char t[4];
+    int i;
+
+    memcpy(rk, user_key, PYI_AES_BLOCK_SIZE);
+
+    for (i = PYI_AES_BLOCK_SIZE; i < (int) sizeof(key->rk); i += 4) {
+        memcpy(t, rk + i - 4, 4);
+
+        if (i % PYI_AES_BLOCK_SIZE == 0) {
+            /* RotWord, SubWord and the round constant. */
+            unsigned char t0 = t[0];
+            t[0] = _sbox[t[1]] ^ rcon;
+            t[1] = _sbox[t[2]];
+            t[2] = _sbox[t[3]];
+            t[3] = _sbox[t0];
+            rcon = XTIME(rcon);
+        }
+        rk[i] = rk[i - PYI_AES_BLOCK_SIZE] ^ t[0];
+        rk[i + 1] = rk[i + 1 - PYI_AES_BLOCK_SIZE] ^ t[1];
+        rk[i + 2] = rk[i + 2 - PYI_AES_BLOCK_SIZE] ^ t[2];
+        rk[i + 3] = rk[i + 3 - PYI_AES_BLOCK_SIZE] ^ t[3];
+    }
+}
+
+/* Encrypt the block 'in' to 'out' (portable implementation). */
+static void
+_encrypt_block(const AES_KEY *key, const unsigned char *in, unsigned char *out)
+{
+    const unsigned char *rk = key->rk;
+    unsigned char s[PYI_AES_BLOCK_SIZE];
+    unsigned char t[PYI_AES_BLOCK_SIZE];
+    unsigned char a0, a1, a2, a3, x;
+    int round, i, c;
+
+    for (i = 0; i < PYI_AES_BLOCK_SIZE; i++) {
+        s[i] = in[i] ^ rk[i];
+    }
+
+    for (round = 1; round <= AES_ROUNDS; round++) {
+        rk += PYI_AES_BLOCK_SIZE;
+
+        /* SubBytes and ShiftRows. The state is stored column by column. */
+        for (i = 0; i < PYI_AES_BLOCK_SIZE; i++) {
+            t[i] = _sbox[s[(i + 4 * (i % 4)) % PYI_AES_BLOCK_SIZE]];
+        }
+
+        if (round == AES_ROUNDS) {
+            for (i = 0; i < PYI_AES_BLOCK_SIZE; i++) {
+                out[i] = t[i] ^ rk[i];
+            }
+            return;
+        }
+
+        /* MixColumns and AddRoundKey. */
+        for (c = 0; c < PYI_AES_BLOCK_SIZE; c += 4) {
+            a0 = t[c];
+            a1 = t[c + 1];
+            a2 = t[c + 2];
+            a3 = t[c + 3];
+            x = a0 ^ a1 ^ a2 ^ a3;
+            s[c] = a0 ^ x ^ XTIME(a0 ^ a1) ^ rk[c];
+            s[c + 1] = a1 ^ x ^ XTIME(a1 ^ a2) ^ rk[c + 1];
+            s[c + 2] = a2 ^ x ^ XTIME(a2 ^ a3) ^ rk[c + 2];
+            s[c + 3] = a3 ^ x ^ XTIME(a3 ^ a0) ^ rk[c + 3];
+        }
+    }
+}
+
+/*
+ * Decrypt the whole blocks of 'in' with the portable implementation. Return
+ * the number of bytes decrypted.
+ */
+static size_t
+_cfb128_decrypt_blocks(const AES_KEY *key, const unsigned char *iv,
+                       const unsigned char *in, unsigned char *out, size_t len)
+{
+    unsigned char ks[PYI_AES_BLOCK_SIZE];
+    const unsigned char *prev = iv;
+    size_t done, i;
+
+    for (done = 0; done + PYI_AES_BLOCK_SIZE <= len; done += PYI_AES_BLOCK_SIZE) {
+        _encrypt_block(key, prev, ks);
+
+        for (i = 0; i < PYI_AES_BLOCK_SIZE; i++) {
+            out[done + i] = in[done + i] ^ ks[i];
+        }
+        prev = in + done;
+    }
+    return done;
+}
+
+#ifdef AES_NI
+
+/* Return non-zero if the processor supports AES-NI. */
+static int
+_have_aes_ni(void)
+{
+    #ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 1);
+    return (info[2] >> 25) & 1;
+    #else
+    return __builtin_cpu_supports("aes");
+    #endif
+}
+
+/* Same as _cfb128_decrypt_blocks(), with AES-NI, four blocks at a time. */
+static AES_NI_TARGET size_t
+_cfb128_decrypt_blocks_ni(const AES_KEY *key, const unsigned char *iv,
+                          const unsigned char *in, unsigned char *out, size_t len)
+{
+    __m128i rk[AES_ROUNDS + 1];
+    __m128i b0, b1, b2, b3;
+    size_t done = 0;
+    int r;
+
+    for (r = 0; r <= AES_ROUNDS; r++) {
+        rk[r] = _mm_loadu_si128((const __m128i *) (key->rk + r * PYI_AES_BLOCK_SIZE));
+    }
+
+    /* The input of the first block is the IV, of the others the previous block. */
+    if (len >= PYI_AES_BLOCK_SIZE) {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) iv), rk[0]);
+
+        for (r = 1; r < AES_ROUNDS; r++) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[AES_ROUNDS]);
+        _mm_storeu_si128((__m128i *) out, _mm_xor_si128(
+                             b0, _mm_loadu_si128((const __m128i *) in)));
+        done = PYI_AES_BLOCK_SIZE;
+    }
+
+    for (; done + 4 * PYI_AES_BLOCK_SIZE <= len; done += 4 * PYI_AES_BLOCK_SIZE) {
+        const unsigned char *prev = in + done - PYI_AES_BLOCK_SIZE;
+
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) prev), rk[0]);
+        b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (prev + 16)), rk[0]);
+        b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (prev + 32)), rk[0]);
+        b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (prev + 48)), rk[0]);
+
+        for (r = 1; r < AES_ROUNDS; r++) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[AES_ROUNDS]);
+        b1 = _mm_aesenclast_si128(b1, rk[AES_ROUNDS]);
+        b2 = _mm_aesenclast_si128(b2, rk[AES_ROUNDS]);
+        b3 = _mm_aesenclast_si128(b3, rk[AES_ROUNDS]);
+
+        _mm_storeu_si128((__m128i *) (out + done), _mm_xor_si128(
+                             b0, _mm_loadu_si128((const __m128i *) (in + done))));
+        _mm_storeu_si128((__m128i *) (out + done + 16), _mm_xor_si128(
+                             b1, _mm_loadu_si128((const __m128i *) (in + done + 16))));
+        _mm_storeu_si128((__m128i *) (out + done + 32), _mm_xor_si128(
+                             b2, _mm_loadu_si128((const __m128i *) (in + done + 32))));
+        _mm_storeu_si128((__m128i *) (out + done + 48), _mm_xor_si128(
+                             b3, _mm_loadu_si128((const __m128i *) (in + done + 48))));
+    }
+
+    for (; done + PYI_AES_BLOCK_SIZE <= len; done += PYI_AES_BLOCK_SIZE) {
+        b0 = _mm_xor_si128(_mm_loadu_si128(
+                               (const __m128i *) (in + done - PYI_AES_BLOCK_SIZE)), rk[0]);
+
+        for (r = 1; r < AES_ROUNDS; r++) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[AES_ROUNDS]);
+        _mm_storeu_si128((__m128i *) (out + done), _mm_xor_si128(
+                             b0, _mm_loadu_si128((const __m128i *) (in + done))));
+    }
+    return done;
+}
+
+#endif /* ifdef AES_NI */
+
+#ifdef AES_ARMV8
+
+/* Encrypt one block with the ARMv8 crypto extension. */
+static uint8x16_t
+_encrypt_block_armv8(const uint8x16_t *rk, uint8x16_t b)
+{
+    int r;
+
+    for (r = 0; r < AES_ROUNDS - 1; r++) {
+        b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+    }
+    b = vaeseq_u8(b, rk[AES_ROUNDS - 1]);
+    return veorq_u8(b, rk[AES_ROUNDS]);
+}
+
+/* Same as _cfb128_decrypt_blocks(), with the ARMv8 crypto extension. */
+static size_t
+_cfb128_decrypt_blocks_armv8(const AES_KEY *key, const unsigned char *iv,
+                             const unsigned char *in, unsigned char *out, size_t len)
+{
+    uint8x16_t rk[AES_ROUNDS + 1];
+    const unsigned char *prev = iv;
+    size_t done;
+    int r;
+
+    for (r = 0; r <= AES_ROUNDS; r++) {
+        rk[r] = vld1q_u8(key->rk + r * PYI_AES_BLOCK_SIZE);
+    }
+
+    for (done = 0; done + PYI_AES_BLOCK_SIZE <= len; done += PYI_AES_BLOCK_SIZE) {
+        vst1q_u8(out + done, veorq_u8(_encrypt_block_armv8(rk, vld1q_u8(prev)),
+                                      vld1q_u8(in + done)));
+        prev = in + done;
+    }
+    return done;
+}
+
+#endif /* ifdef AES_ARMV8 */
+
+void
+pyi_aes_cfb128_decrypt(const unsigned char *key, const unsigned char *iv,
+                       const unsigned char *in, unsigned char *out, size_t len)
+{
+    AES_KEY aes_key;
+    unsigned char ks[PYI_AES_BLOCK_SIZE];
+    size_t done, i;
+
+    _expand_key(&aes_key, key);
+
+#if defined(AES_NI)
+
+    if (_have_aes_ni()) {
+        done = _cfb128_decrypt_blocks_ni(&aes_key, iv, in, out, len);
+    }
+    else {
+        done = _cfb128_decrypt_blocks(&aes_key, iv, in, out, len);
+    }
+#elif defined(AES_ARMV8)
+    done = _cfb128_decrypt_blocks_armv8(&aes_key, iv, in, out, len);
+#else
+    done = _cfb128_decrypt_blocks(&aes_key, iv, in, out, len);
+#endif
+
+    /* The last segment may be shorter than a block. */
+    if (done < len) {
+        _encrypt_block(&aes_key, done ? in + done - PYI_AES_BLOCK_SIZE : iv, ks);
+
+        for (i = 0; done + i < len; i++) {
+            out[done + i] = in[done + i] ^ ks[i];
+        }
+    }
+}
+
+/* sys._pyi_aes_cfb128_decrypt(key, data) */
+static PyObject *
+_py_cfb128_decrypt(PyObject *self, PyObject *args)
+{
+    PyObject *key_obj = PI_PyTuple_GetItem(args, 0);
+    PyObject *data_obj = PI_PyTuple_GetItem(args, 1);
+    PyObject *result;
+    char *key;
+    char *data;
+    ptrdiff_t key_len, data_len;
+
+    if (key_obj == NULL || data_obj == NULL ||
+        PI_PyBytes_AsStringAndSize(key_obj, &key, &key_len) < 0 ||
+        PI_PyBytes_AsStringAndSize(data_obj, &data, &data_len) < 0) {
+        return NULL;
+    }
+
+    if (key_len != PYI_AES_BLOCK_SIZE || data_len < PYI_AES_BLOCK_SIZE) {
+        PI_PyErr_SetString(*PI_PyExc_ValueError, "invalid AES key or data length");
+        return NULL;
+    }
+
+    result = PI_PyBytes_FromStringAndSize(NULL, data_len - PYI_AES_BLOCK_SIZE);
+
+    if (result != NULL) {
+        pyi_aes_cfb128_decrypt(
+            (const unsigned char *) key, (const unsigned char *) data,
+            (const unsigned char *) data + PYI_AES_BLOCK_SIZE,
+            (unsigned char *) PI_PyBytes_AsString(result),
+            (size_t) data_len - PYI_AES_BLOCK_SIZE);
+    }
+    return result;
+}
+
+static PyMethodDef _cfb128_decrypt_def = {
+    "_pyi_aes_cfb128_decrypt", _py_cfb128_decrypt, METH_VARARGS,
+    "Decrypt IV + ciphertext with AES-128 in CFB mode (128-bit segments)."
+};
+
+int
+pyi_aes_install(void)
+{
+    PyObject *func;
+
+    if (is_py2) {
+        return 0;
+    }
+    VS("LOADER: setting sys._pyi_aes_cfb128_decrypt\n");
+
+    func = PI_PyCFunction_NewEx(&_cfb128_decrypt_def, NULL, NULL);
+
+    if (func == NULL || PI_PySys_SetObject("_pyi_aes_cfb128_decrypt", func) < 0) {
+        return -1;
+    }
+    PI_Py_DecRef(func);
+    return 0;
+}
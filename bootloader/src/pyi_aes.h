@@ -0,0 +1,40 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * AES decryption of encrypted PYZ archives.
+ */
+
+#ifndef PYI_AES_H
+#define PYI_AES_H
+
+#include <stddef.h>  /* size_t */
+
+/* Key and block size of AES-128, in bytes. */
+#define PYI_AES_BLOCK_SIZE  16
+
+/*
+ * Decrypt 'len' bytes from 'in' to 'out' with AES-128 in CFB mode with
+ * 128-bit segments. 'key' and 'iv' are PYI_AES_BLOCK_SIZE bytes long.
+ */
+void pyi_aes_cfb128_decrypt(const unsigned char *key, const unsigned char *iv,
+                            const unsigned char *in, unsigned char *out,
+                            size_t len);
+
+/*
+ * Make the decryption available to the bootstrap code as the built-in
+ * function sys._pyi_aes_cfb128_decrypt(key, data), where data is the IV
+ * followed by the ciphertext. Python 3 only.
+ *
+ * Return 0 on success.
+ */
+int pyi_aes_install(void);
+
+#endif  /* PYI_AES_H */
@@ -28,7 +28,7 @@
     #endif
     #include <stdlib.h>   /* malloc */
     #include <string.h>   /* strncmp, strcpy, strcat */
-    #include <sys/stat.h> /* fchmod */
+    #include <unistd.h>   /* close */
 #endif /* ifdef _WIN32 */
 #include <stddef.h>  /* ptrdiff_t */
 #include <stdio.h>
@@ -46,6 +46,9 @@ int pyvers = 0;
 /* Magic number to verify archive data are bundled correctly. */
 #define MAGIC "MEI\014\013\012\013\016"
 
+/* Size of the reads of pyi_arch_verify_entry(). */
+#define CHUNK_SIZE (256 * 1024)
+
 /*
  * Return pointer to next toc entry.
  */
@@ -91,137 +94,521 @@ pyi_arch_close_fp(ARCHIVE_STATUS *status)
 }
 
 /*
- * Decompress data in buff, described by ptoc.
- * Return in malloc'ed buffer (needs to be freed)
+ * Decompress data in buff, described by ptoc, into out, which must hold
+ * ntohl(ptoc->ulen) bytes. The z_stream of the archive is set up by the
+ * first call and reset for every further entry.
+ * Return 0 on success.
  */
-static unsigned char *
-decompress(unsigned char * buff, TOC *ptoc)
+static int
+decompress_into(ARCHIVE_STATUS *status, unsigned char * buff, TOC *ptoc,
+                unsigned char *out)
 {
-    const char *ver;
-    unsigned char *out;
-    z_stream zstream;
+    z_stream *zstream = status->zstream;
     int rc;
 
-    ver = (zlibVersion)();
-    out = (unsigned char *)malloc(ntohl(ptoc->ulen));
+    if (zstream == NULL) {
+        zstream = (z_stream *) calloc(1, sizeof(z_stream));
 
-    if (out == NULL) {
-        OTHERERROR("Error allocating decompression buffer\n");
-        return NULL;
+        if (zstream == NULL) {
+            OTHERERROR("Error allocating decompression state\n");
+            return -1;
+        }
+        rc = inflateInit(zstream);
+
+        if (rc < 0) {
+            OTHERERROR("Error %d from inflateInit: %s\n", rc, zstream->msg);
+            free(zstream);
+            return -1;
+        }
+        status->zstream = zstream;
     }
+    else {
+        rc = (inflateReset)(zstream);
 
-    zstream.zalloc = NULL;
-    zstream.zfree = NULL;
-    zstream.opaque = NULL;
-    zstream.next_in = buff;
-    zstream.avail_in = ntohl(ptoc->len);
-    zstream.next_out = out;
-    zstream.avail_out = ntohl(ptoc->ulen);
-    rc = inflateInit(&zstream);
+        if (rc < 0) {
+            OTHERERROR("Error %d from inflateReset: %s\n", rc, zstream->msg);
+            return -1;
+        }
+    }
 
-    if (rc >= 0) {
-        rc = (inflate)(&zstream, Z_FINISH);
+    zstream->next_in = buff;
+    zstream->avail_in = ntohl(ptoc->len);
+    zstream->next_out = out;
+    zstream->avail_out = ntohl(ptoc->ulen);
+    rc = (inflate)(zstream, Z_FINISH);
 
-        if (rc >= 0) {
-            rc = (inflateEnd)(&zstream);
+    if (rc < 0) {
+        OTHERERROR("Error %d from inflate: %s\n", rc, zstream->msg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Return a buffer of at least 'len' bytes in *buf, replacing it by a larger
+ * one if needed. The contents are not preserved.
+ */
+static unsigned char *
+_reserve(unsigned char **buf, size_t *size, size_t len)
+{
+    if (*buf == NULL || *size < len) {
+        free(*buf);
+        /* Allocate at least one byte: malloc(0) may return NULL. */
+        *buf = (unsigned char *) malloc(len ? len : 1);
+        *size = *buf ? len : 0;
+
+        if (*buf == NULL) {
+            OTHERERROR("Could not allocate read buffer\n");
         }
-        else {
-            OTHERERROR("Error %d from inflate: %s\n", rc, zstream.msg);
-            return NULL;
+    }
+    return *buf;
+}
+
+/*
+ * Size the buffers of the archive for the largest binary or data file, so
+ * that extracting them to the filesystem allocates no memory per entry.
+ * Release them with pyi_arch_free_buffers().
+ */
+int
+pyi_arch_init_buffers(ARCHIVE_STATUS *status)
+{
+    TOC *ptoc = status->tocbuff;
+    size_t maxlen = 0;
+    size_t maxulen = 0;
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd == ARCHIVE_ITEM_BINARY || ptoc->typcd == ARCHIVE_ITEM_DATA ||
+            ptoc->typcd == ARCHIVE_ITEM_ZIPFILE) {
+            if (ptoc->cflag == '\1' && ntohl(ptoc->len) > maxlen) {
+                maxlen = ntohl(ptoc->len);
+            }
+
+            if (ntohl(ptoc->ulen) > maxulen) {
+                maxulen = ntohl(ptoc->ulen);
+            }
         }
     }
-    else {
-        OTHERERROR("Error %d from inflateInit: %s\n", rc, zstream.msg);
-        return NULL;
+
+    if (_reserve(&status->readbuf, &status->readbuf_size, maxlen) == NULL ||
+        _reserve(&status->outbuf, &status->outbuf_size, maxulen) == NULL) {
+        return -1;
     }
+    return 0;
+}
 
-    return out;
+void
+pyi_arch_free_buffers(ARCHIVE_STATUS *status)
+{
+    free(status->readbuf);
+    free(status->outbuf);
+    status->readbuf = status->outbuf = NULL;
+    status->readbuf_size = status->outbuf_size = 0;
 }
 
 /*
- * Extract an archive entry.
+ * Read 'len' bytes of archive data starting at offset 'pos' (relative to
+ * the start of the package) with a single read.
  * Returns pointer to the data (must be freed).
  */
 unsigned char *
-pyi_arch_extract(ARCHIVE_STATUS *status, TOC *ptoc)
+pyi_arch_read_raw(ARCHIVE_STATUS *status, size_t pos, size_t len)
 {
     unsigned char *data;
-    unsigned char *tmp;
 
     if (pyi_arch_open_fp(status) != 0) {
         OTHERERROR("Cannot open archive file\n");
         return NULL;
     }
 
-    fseek(status->fp, status->pkgstart + ntohl(ptoc->pos), SEEK_SET);
-    data = (unsigned char *)malloc(ntohl(ptoc->len));
+    fseek(status->fp, status->pkgstart + pos, SEEK_SET);
+    /* Allocate at least one byte: malloc(0) may return NULL. */
+    data = (unsigned char *)malloc(len ? len : 1);
 
     if (data == NULL) {
         OTHERERROR("Could not allocate read buffer\n");
         return NULL;
     }
 
-    if (fread(data, ntohl(ptoc->len), 1, status->fp) < 1) {
+    if (len > 0 && fread(data, len, 1, status->fp) < 1) {
         OTHERERROR("Could not read from file\n");
         free(data);
         return NULL;
     }
 
-    if (ptoc->cflag == '\1') {
-        tmp = decompress(data, ptoc);
-        free(data);
-        data = tmp;
+    pyi_arch_close_fp(status);
+    return data;
+}
+
+/*
+ * Get the uncompressed data of the entry ptoc from its raw data in the
+ * archive, as read by pyi_arch_read_raw(). Uncompressed entries are
+ * returned in place, compressed ones are decompressed into 'out', which
+ * must hold ntohl(ptoc->ulen) bytes.
+ * Returns NULL on error.
+ */
+unsigned char *
+pyi_arch_extract_from(ARCHIVE_STATUS *status, TOC *ptoc, unsigned char *raw,
+                      unsigned char *out)
+{
+    if (ptoc->cflag != '\1') {
+        return raw;
+    }
+
+    if (decompress_into(status, raw, ptoc, out) != 0) {
+        OTHERERROR("Error decompressing %s\n", ptoc->name);
+        return NULL;
+    }
+    return out;
+}
+
+static int
+_compare_digests(const void *a, const void *b)
+{
+    unsigned int x = ((const DIGEST *) a)->tocpos;
+    unsigned int y = ((const DIGEST *) b)->tocpos;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Return the digest of the entry ptoc, or NULL if it has none. */
+static const DIGEST *
+_find_digest(const ARCHIVE_STATUS *status, const TOC *ptoc)
+{
+    DIGEST key;
+
+    if (status->digests == NULL) {
+        return NULL;
+    }
+    key.tocpos = (unsigned int) ((const char *) ptoc - (const char *) status->tocbuff);
+    return (const DIGEST *) bsearch(&key, status->digests, status->ndigests,
+                                    sizeof(DIGEST), _compare_digests);
+}
+
+/*
+ * Verify the raw (as stored) data of the entry ptoc against its CRC-32 in
+ * the digests entry. Archives without digests are not checked.
+ * Return 0 if the data is intact.
+ */
+int
+pyi_arch_check_digest(const ARCHIVE_STATUS *status, const TOC *ptoc,
+                      const unsigned char *raw)
+{
+    const DIGEST *digest = _find_digest(status, ptoc);
+
+    if (digest == NULL) {
+        return 0;
+    }
+
+    if ((unsigned int) crc32(0L, raw, ntohl(ptoc->len)) != digest->crc) {
+        FATALERROR("%s is corrupt: checksum mismatch in %s\n",
+                   status->archivename, ptoc->name);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Verify the entry ptoc against its digest without extracting it, for
+ * entries read by Python rather than by the bootloader (PYZ archives). The
+ * data is read in chunks, not held in memory. Return 0 if it is intact.
+ */
+int
+pyi_arch_verify_entry(ARCHIVE_STATUS *status, const TOC *ptoc)
+{
+    const DIGEST *digest = _find_digest(status, ptoc);
+    unsigned char *buf;
+    size_t left = ntohl(ptoc->len);
+    size_t n;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    int rc = 0;
+
+    if (digest == NULL) {
+        return 0;
+    }
+
+    if (pyi_arch_open_fp(status) != 0) {
+        OTHERERROR("Cannot open archive file\n");
+        return -1;
+    }
+    buf = (unsigned char *) malloc(CHUNK_SIZE);
+
+    if (buf == NULL) {
+        FATAL_PERROR("malloc", "Could not allocate read buffer\n");
+        pyi_arch_close_fp(status);
+        return -1;
+    }
+    fseek(status->fp, status->pkgstart + ntohl(ptoc->pos), SEEK_SET);
+
+    while (left > 0) {
+        n = left < CHUNK_SIZE ? left : CHUNK_SIZE;
 
-        if (data == NULL) {
-            OTHERERROR("Error decompressing %s\n", ptoc->name);
-            return NULL;
+        if (fread(buf, n, 1, status->fp) < 1) {
+            OTHERERROR("Could not read from file\n");
+            rc = -1;
+            break;
         }
+        crc = crc32(crc, buf, (uInt) n);
+        left -= n;
     }
 
+    if (rc == 0 && (unsigned int) crc != digest->crc) {
+        FATALERROR("%s is corrupt: checksum mismatch in %s\n",
+                   status->archivename, ptoc->name);
+        rc = -1;
+    }
+    free(buf);
     pyi_arch_close_fp(status);
+    return rc;
+}
+
+/*
+ * Read the digests entry (type 'h', the last entry of the TOC), if there is
+ * one, and verify the TOC. Called by pyi_arch_open() with status->fp open.
+ * Return 0 on success.
+ */
+static int
+_read_digests(ARCHIVE_STATUS *status)
+{
+    TOC *ptoc = status->tocbuff;
+    TOC *last = NULL;
+    unsigned int *data;
+    int count = 0;
+    int i;
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        last = ptoc;
+        count++;
+    }
+
+    if (last == NULL || last->typcd != ARCHIVE_ITEM_DIGESTS) {
+        return 0;
+    }
+    count--;
+
+    if (ntohl(last->len) != (unsigned int) (4 * (count + 2)) ||
+        (data = (unsigned int *) malloc(ntohl(last->len))) == NULL) {
+        FATALERROR("%s is corrupt: invalid digests\n", status->archivename);
+        return -1;
+    }
+    fseek(status->fp, status->pkgstart + ntohl(last->pos), SEEK_SET);
+
+    if (fread(data, ntohl(last->len), 1, status->fp) < 1 ||
+        ntohl(data[0]) != (unsigned int) count) {
+        FATALERROR("%s is corrupt: invalid digests\n", status->archivename);
+        free(data);
+        return -1;
+    }
+
+    if ((unsigned int) crc32(0L, (unsigned char *) status->tocbuff,
+                             ntohl(status->cookie.TOClen)) != ntohl(data[count + 1])) {
+        FATALERROR("%s is corrupt: checksum mismatch in table of contents\n",
+                   status->archivename);
+        free(data);
+        return -1;
+    }
+
+    /* Allocate at least one element: malloc(0) may return NULL. */
+    status->digests = (DIGEST *) malloc((count ? count : 1) * sizeof(DIGEST));
+
+    if (status->digests == NULL) {
+        FATAL_PERROR("malloc", "Could not allocate buffer for digests.");
+        free(data);
+        return -1;
+    }
+
+    for (i = 0, ptoc = status->tocbuff; i < count;
+         i++, ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        status->digests[i].tocpos = (unsigned int) ((char *) ptoc - (char *) status->tocbuff);
+        status->digests[i].crc = ntohl(data[i + 1]);
+    }
+    status->ndigests = count;
+    free(data);
+    return 0;
+}
+
+/*
+ * Read the data of the entry ptoc, as stored, into 'data' and verify it.
+ * Return 0 on success.
+ */
+static int
+_read_entry(ARCHIVE_STATUS *status, TOC *ptoc, unsigned char *data)
+{
+    if (pyi_arch_open_fp(status) != 0) {
+        OTHERERROR("Cannot open archive file\n");
+        return -1;
+    }
+
+    fseek(status->fp, status->pkgstart + ntohl(ptoc->pos), SEEK_SET);
+
+    if (ntohl(ptoc->len) > 0 && fread(data, ntohl(ptoc->len), 1, status->fp) < 1) {
+        OTHERERROR("Could not read from file\n");
+        return -1;
+    }
+
+    if (pyi_arch_check_digest(status, ptoc, data) != 0) {
+        return -1;
+    }
+    pyi_arch_close_fp(status);
+    return 0;
+}
+
+/*
+ * Extract an archive entry into 'out', which must hold ntohl(ptoc->ulen)
+ * bytes. Compressed data is read into the read buffer of the archive.
+ * Return 0 on success.
+ */
+static int
+_extract_into(ARCHIVE_STATUS *status, TOC *ptoc, unsigned char *out)
+{
+    unsigned char *raw;
+
+    if (ptoc->cflag != '\1') {
+        return _read_entry(status, ptoc, out);
+    }
+    raw = _reserve(&status->readbuf, &status->readbuf_size, ntohl(ptoc->len));
+
+    if (raw == NULL || _read_entry(status, ptoc, raw) != 0) {
+        return -1;
+    }
+
+    if (decompress_into(status, raw, ptoc, out) != 0) {
+        OTHERERROR("Error decompressing %s\n", ptoc->name);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Extract an archive entry.
+ * Returns pointer to the data (must be freed).
+ */
+unsigned char *
+pyi_arch_extract(ARCHIVE_STATUS *status, TOC *ptoc)
+{
+    unsigned char *data;
+
+    /* Allocate at least one byte: malloc(0) may return NULL. */
+    data = (unsigned char *) malloc(ntohl(ptoc->ulen) ? ntohl(ptoc->ulen) : 1);
+
+    if (data == NULL) {
+        OTHERERROR("Could not allocate read buffer\n");
+        return NULL;
+    }
+
+    if (_extract_into(status, ptoc, data) != 0) {
+        free(data);
+        return NULL;
+    }
     return data;
 }
 
 /*
- * Extract from the archive and copy to the filesystem.
- * The path is relative to the directory the archive is in.
+ * Extract from the archive and copy to the filesystem as 'name'.
+ * The path is relative to the temporary directory.
  */
-int
-pyi_arch_extract2fs(ARCHIVE_STATUS *status, TOC *ptoc)
+static int
+_extract2fs(ARCHIVE_STATUS *status, TOC *ptoc, const char *name)
 {
     FILE *out;
     size_t result, len;
-    unsigned char *data = pyi_arch_extract(status, ptoc);
+#ifndef _WIN32
+    int fd;
+#endif
+    /* The output buffer of the archive is reused for every file. */
+    unsigned char *data = _reserve(&status->outbuf, &status->outbuf_size,
+                                   ntohl(ptoc->ulen));
+
+    if (data == NULL || _extract_into(status, ptoc, data) != 0) {
+        return -1;
+    }
 
     /* Create tmp dir _MEIPASSxxx. */
     if (pyi_create_temp_path(status) == -1) {
         return -1;
     }
 
-    out = pyi_open_target(status->temppath, ptoc->name);
+#ifdef _WIN32
+    out = pyi_open_target(status->temppath, name);
+#else
+    fd = pyi_open_target_fd(status, name);
+    out = fd < 0 ? NULL : fdopen(fd, "wb");
+
+    if (fd >= 0 && out == NULL) {
+        close(fd);
+    }
+#endif
     len = ntohl(ptoc->ulen);
 
     if (out == NULL) {
-        FATAL_PERROR("fopen", "%s could not be extracted!\n", ptoc->name);
+        FATAL_PERROR("fopen", "%s could not be extracted!\n", name);
         return -1;
     }
     else {
         result = fwrite(data, len, 1, out);
 
         if ((1 != result) && (len > 0)) {
-            FATAL_PERROR("fwrite", "Failed to write all bytes for %s\n", ptoc->name);
+            FATAL_PERROR("fwrite", "Failed to write all bytes for %s\n", name);
             return -1;
         }
-#ifndef WIN32
-        fchmod(fileno(out), S_IRUSR | S_IWUSR | S_IXUSR);
-#endif
         fclose(out);
     }
-    free(data);
 
     return 0;
 }
 
+/*
+ * Extract from the archive and copy to the filesystem.
+ * The path is relative to the directory the archive is in.
+ */
+int
+pyi_arch_extract2fs(ARCHIVE_STATUS *status, TOC *ptoc)
+{
+    return _extract2fs(status, ptoc, ptoc->name);
+}
+
+#ifndef _WIN32
+
+/*
+ * Like pyi_arch_extract2fs(), but write the file under a temporary name and
+ * rename it into place once it is complete. Used for files extracted while
+ * the application is already running, so that a file which exists under its
+ * final name is never only partially written.
+ */
+int
+pyi_arch_extract2fs_rename(ARCHIVE_STATUS *status, TOC *ptoc)
+{
+    char partname[PATH_MAX];
+    char partpath[PATH_MAX];
+    char filepath[PATH_MAX];
+
+    if (snprintf(partname, PATH_MAX, "%s%s", ptoc->name,
+                 PYI_PARTIAL_SUFFIX) >= PATH_MAX) {
+        FATALERROR("Path exceeds PATH_MAX: %s\n", ptoc->name);
+        return -1;
+    }
+
+    if (_extract2fs(status, ptoc, partname)) {
+        return -1;
+    }
+
+    if (snprintf(partpath, PATH_MAX, "%s%s%s", status->temppath, PYI_SEPSTR,
+                 partname) >= PATH_MAX ||
+        snprintf(filepath, PATH_MAX, "%s%s%s", status->temppath, PYI_SEPSTR,
+                 ptoc->name) >= PATH_MAX) {
+        FATALERROR("Path exceeds PATH_MAX: %s\n", ptoc->name);
+        return -1;
+    }
+
+    if (rename(partpath, filepath) < 0) {
+        FATAL_PERROR("rename", "%s could not be extracted!\n", ptoc->name);
+        return -1;
+    }
+    return 0;
+}
+
+#endif /* ifndef _WIN32 */
+
 /*
  * Look for the predefined string MAGIC in the embedded data before the given
  * search end position. If MAGIC is found, copies the entire COOKIE struct into
@@ -435,6 +822,10 @@ pyi_arch_open(ARCHIVE_STATUS *status)
     }
     status->tocend = (TOC *) (((char *)status->tocbuff) + ntohl(status->cookie.TOClen));
 
+    if (_read_digests(status) != 0) {
+        return -1;
+    }
+
     /* Check input file is still ok (should be). */
     if (ferror(status->fp)) {
         FATALERROR("Error on file\n.");
@@ -543,8 +934,18 @@ pyi_arch_status_free_memory(ARCHIVE_STATUS *archive_status)
         if (archive_status->tocbuff != NULL) {
             free(archive_status->tocbuff);
         }
+        free(archive_status->digests);
+        pyi_arch_free_buffers(archive_status);
+
+        if (archive_status->zstream != NULL) {
+            (inflateEnd)(archive_status->zstream);
+            free(archive_status->zstream);
+        }
         /* Close file handler */
         pyi_arch_close_fp(archive_status);
+#ifndef _WIN32
+        pyi_close_target_dirs(archive_status);
+#endif
         free(archive_status);
     }
 }
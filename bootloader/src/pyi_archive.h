@@ -25,6 +25,8 @@
 #define ARCHIVE_ITEM_PYSOURCE         's'  /* Python script (v3) */
 #define ARCHIVE_ITEM_DATA             'x'  /* data */
 #define ARCHIVE_ITEM_RUNTIME_OPTION   'o'  /* runtime option */
+#define ARCHIVE_ITEM_FROZEN_MODULES   'f'  /* frozen modules (Python 3 base library) */
+#define ARCHIVE_ITEM_DIGESTS          'h'  /* CRC-32 of the entries and of the TOC */
 
 /* TOC entry for a CArchive */
 typedef struct _toc {
@@ -49,12 +51,33 @@ typedef struct _cookie {
     char pylibname[64]; /* Filename of Python dynamic library e.g. python2.7.dll. */
 } COOKIE;
 
+/* CRC-32 of the stored data of a TOC entry, from the digests entry. */
+typedef struct _digest {
+    unsigned int tocpos;  /* offset of the TOC entry in the TOC */
+    unsigned int crc;
+} DIGEST;
+
 typedef struct _archive_status {
     FILE * fp;
     int    pkgstart;
     TOC *  tocbuff;
     TOC *  tocend;
     COOKIE cookie;
+    /*
+     * Digests of the entries, sorted by tocpos, or NULL if the archive has
+     * no digests entry. See pyi_arch_check_digest().
+     */
+    DIGEST *digests;
+    int     ndigests;
+    /*
+     * Decompression state, reset for every entry, and the read and output
+     * buffers reused by the extraction. See pyi_arch_init_buffers().
+     */
+    struct z_stream_s *zstream;
+    unsigned char     *readbuf;
+    size_t             readbuf_size;
+    unsigned char     *outbuf;
+    size_t             outbuf_size;
     /*
      * On Windows:
      *    These strings are UTF-8 encoded (via pyi_win32_utils_to_utf8). On Python 2,
@@ -82,6 +105,17 @@ typedef struct _archive_status {
      * in this mode.
      */
     bool has_temp_directory;
+#ifndef _WIN32
+    /*
+     * Directories below temppath are created up front from the TOC, see
+     * pyi_create_temp_path(). Files are then opened relative to descriptors
+     * of temppath and of the directory of the previous file.
+     */
+    bool has_target_dirs;
+    int  tempfd;
+    int  lastdirfd;
+    char lastdir[PATH_MAX];
+#endif
     /*
      * Flag if Python library was loaded. This indicates if it is safe
      * to call function PI_Py_Finalize(). If Python dll is missing
@@ -96,12 +130,30 @@ typedef struct _archive_status {
                        * On Windows, UTF-8 encoded form of __wargv.
                        * On OS X/Linux, as received in main()
                        */
+    /*
+     * Name of the script selected by pyi_launch_select_entrypoint() if the
+     * executable has several entry points (pyi-entrypoints option).
+     */
+    const char *entrypoint;
 } ARCHIVE_STATUS;
 
 TOC *pyi_arch_increment_toc_ptr(const ARCHIVE_STATUS *status, const TOC* ptoc);
 
 unsigned char *pyi_arch_extract(ARCHIVE_STATUS *status, TOC *ptoc);
+unsigned char *pyi_arch_read_raw(ARCHIVE_STATUS *status, size_t pos, size_t len);
+unsigned char *pyi_arch_extract_from(ARCHIVE_STATUS *status, TOC *ptoc,
+                                     unsigned char *raw, unsigned char *out);
+int pyi_arch_init_buffers(ARCHIVE_STATUS *status);
+void pyi_arch_free_buffers(ARCHIVE_STATUS *status);
+int pyi_arch_check_digest(const ARCHIVE_STATUS *status, const TOC *ptoc,
+                          const unsigned char *raw);
+int pyi_arch_verify_entry(ARCHIVE_STATUS *status, const TOC *ptoc);
 int pyi_arch_extract2fs(ARCHIVE_STATUS *status, TOC *ptoc);
+#ifndef _WIN32
+/* Suffix of files that are still being written by pyi_arch_extract2fs_rename(). */
+#define PYI_PARTIAL_SUFFIX ".pyi-partial"
+int pyi_arch_extract2fs_rename(ARCHIVE_STATUS *status, TOC *ptoc);
+#endif
 
 /**
  * Helpers for embedders
@@ -47,10 +47,33 @@
 #include "pyi_utils.h"
 #include "pyi_python.h"
 #include "pyi_pythonlib.h"
+#include "pyi_launch.h"
+#include "pyi_aes.h"
+#include "pyi_uring.h"
+#include "pyi_zygote.h"
 #include "pyi_win32_utils.h"  /* CreateActContext */
 
-/* Max count of possible opened archives in multipackage mode. */
-#define _MAX_ARCHIVE_POOL_LEN 20
+/*
+ * 'Multipackage' feature: another executable (or .pkg) that dependencies
+ * (type 'd') are extracted from. The names of the files are collected while
+ * the TOC of the main archive is processed and then extracted in a single
+ * pass over the TOC of this archive, see _extract_archive_dependencies().
+ */
+typedef struct _dependency_archive {
+    /* Path as given in the 'd' entries, relative to homepath. */
+    char path[PATH_MAX];
+    ARCHIVE_STATUS *status;
+    /* File names, pointing into the TOC of the main archive. */
+    const char **names;
+    size_t count;
+    size_t size;
+} DEPENDENCY_ARCHIVE;
+
+typedef struct _dependencies {
+    DEPENDENCY_ARCHIVE *archives;
+    size_t count;
+    size_t size;
+} DEPENDENCIES;
 
 /*
  * The functions in this file defined in reverse order so that forward
@@ -70,28 +93,6 @@ checkFile(char *buf, const char *fmt, ...)
     return stat(buf, &tmp);
 }
 
-/* Splits the item in the form path:filename */
-static int
-splitName(char *path, char *filename, const char *item)
-{
-    char name[PATH_MAX + 1];
-
-    VS("LOADER: Splitting item into path and filename\n");
-    strncpy(name, item, PATH_MAX + 1);
-
-    if (name[PATH_MAX] != '\0') {
-        return -1;
-    }
-
-    strcpy(path, strtok(name, ":"));
-    strcpy(filename, strtok(NULL, ":"));
-
-    if (path[0] == 0 || filename[0] == 0) {
-        return -1;
-    }
-    return 0;
-}
-
 /* Copy the dependencies file from a directory to the tempdir */
 static int
 copyDependencyFromDir(ARCHIVE_STATUS *status, const char *srcpath, const char *filename)
@@ -109,51 +110,81 @@ copyDependencyFromDir(ARCHIVE_STATUS *status, const char *srcpath, const char *f
 }
 
 /*
- * Look for the archive identified by path into the ARCHIVE_STATUS pool archive_pool.
- * If the archive is found, a pointer to the associated ARCHIVE_STATUS is returned
- * otherwise the needed archive is opened and added to the pool and then returned.
+ * Open the archive of the dependency path 'path' (of length 'len'), in
+ * homepath as path.pkg, path.exe or path, and add it to 'deps'. The
+ * archive of a path is looked up and opened only once.
  * If an error occurs, returns NULL.
  *
  * Having several archives is useful for sharing binary dependencies with several
  * executables (multipackage feature).
  */
-static ARCHIVE_STATUS *
-_get_archive(ARCHIVE_STATUS *archive_pool[], const char *path)
+static DEPENDENCY_ARCHIVE *
+_get_archive(ARCHIVE_STATUS *archive_status, DEPENDENCIES *deps,
+             const char *path, size_t len)
 {
-    ARCHIVE_STATUS *archive = NULL;
-    int index = 0;
-    int SELF = 0;
+    DEPENDENCY_ARCHIVE *archive;
+    ARCHIVE_STATUS *status;
+    char archive_path[PATH_MAX];
+    size_t index;
+
+    for (index = 0; index < deps->count; index++) {
+        if (strncmp(deps->archives[index].path, path, len) == 0 &&
+            deps->archives[index].path[len] == '\0') {
+            return &deps->archives[index];
+        }
+    }
+
+    if (len >= PATH_MAX) {
+        FATALERROR("Archive path exceeds PATH_MAX\n");
+        return NULL;
+    }
 
     VS("LOADER: Getting file from archive.\n");
 
-    if (pyi_create_temp_path(archive_pool[SELF]) == -1) {
+    if (pyi_create_temp_path(archive_status) == -1) {
+        return NULL;
+    }
+
+    /* TODO implement pyi_path_join to accept variable length of arguments for this case. */
+    if ((checkFile(archive_path, "%s%s%.*s.pkg", archive_status->homepath, PYI_SEPSTR,
+                   (int) len, path) != 0) &&
+        (checkFile(archive_path, "%s%s%.*s.exe", archive_status->homepath, PYI_SEPSTR,
+                   (int) len, path) != 0) &&
+        (checkFile(archive_path, "%s%s%.*s", archive_status->homepath, PYI_SEPSTR,
+                   (int) len, path) != 0)) {
+        FATALERROR("Archive not found: %s\n", archive_path);
         return NULL;
     }
 
-    for (index = 1; archive_pool[index] != NULL; index++) {
-        if (strcmp(archive_pool[index]->archivename, path) == 0) {
-            VS("LOADER: Archive found: %s\n", path);
-            return archive_pool[index];
+    if (deps->count == deps->size) {
+        archive = (DEPENDENCY_ARCHIVE *) realloc(deps->archives,
+                                                 (deps->size * 2 + 4) *
+                                                 sizeof(DEPENDENCY_ARCHIVE));
+
+        if (archive == NULL) {
+            FATAL_PERROR("realloc", "Error allocating memory for archives\n");
+            return NULL;
         }
-        VS("LOADER: Checking next archive in the list...\n");
+        deps->archives = archive;
+        deps->size = deps->size * 2 + 4;
     }
 
-    archive = (ARCHIVE_STATUS *) malloc(sizeof(ARCHIVE_STATUS));
+    status = (ARCHIVE_STATUS *) calloc(1, sizeof(ARCHIVE_STATUS));
 
-    if (archive == NULL) {
-        FATAL_PERROR("malloc", "Error allocating memory for status\n");
+    if (status == NULL) {
+        FATAL_PERROR("calloc", "Error allocating memory for status\n");
         return NULL;
     }
 
-    strncpy(archive->archivename, path, PATH_MAX);
-    strncpy(archive->homepath, archive_pool[SELF]->homepath, PATH_MAX);
-    strncpy(archive->temppath, archive_pool[SELF]->temppath, PATH_MAX);
+    strncpy(status->archivename, archive_path, PATH_MAX);
+    strncpy(status->homepath, archive_status->homepath, PATH_MAX);
+    strncpy(status->temppath, archive_status->temppath, PATH_MAX);
 
-    if (archive->archivename[PATH_MAX-1] != '\0'
-        || archive->homepath[PATH_MAX-1] != '\0'
-        || archive->temppath[PATH_MAX-1] != '\0') {
+    if (status->archivename[PATH_MAX-1] != '\0'
+        || status->homepath[PATH_MAX-1] != '\0'
+        || status->temppath[PATH_MAX-1] != '\0') {
         FATALERROR("Archive path exceeds PATH_MAX\n");
-        free(archive);
+        free(status);
         return NULL;
     }
 
@@ -161,29 +192,72 @@ _get_archive(ARCHIVE_STATUS *archive_pool[], const char *path)
      * Setting this flag prevents creating another temp directory and
      * the directory from the main archive status is used.
      */
-    archive->has_temp_directory = archive_pool[SELF]->has_temp_directory;
+    status->has_temp_directory = archive_status->has_temp_directory;
 
-    if (pyi_arch_open(archive)) {
-        FATAL_PERROR("malloc", "Error opening archive %s\n", path);
-        free(archive);
+    if (pyi_arch_open(status)) {
+        FATAL_PERROR("malloc", "Error opening archive %s\n", archive_path);
+        free(status);
         return NULL;
     }
 
-    archive_pool[index] = archive;
+    archive = &deps->archives[deps->count++];
+    memset(archive, 0, sizeof(DEPENDENCY_ARCHIVE));
+    memcpy(archive->path, path, len);
+    archive->path[len] = '\0';
+    archive->status = status;
+    VS("LOADER: Opened archive %s\n", archive_path);
     return archive;
 }
 
-/* Extract a file identifed by filename from the archive associated to status. */
+/* Add the file 'name' to the files to extract from 'archive'. */
+static int
+_add_archive_dependency(DEPENDENCY_ARCHIVE *archive, const char *name)
+{
+    const char **names;
+
+    if (archive->count == archive->size) {
+        names = (const char **) realloc(archive->names,
+                                        (archive->size * 2 + 16) * sizeof(char *));
+
+        if (names == NULL) {
+            FATAL_PERROR("realloc", "Error allocating memory for dependencies\n");
+            return -1;
+        }
+        archive->names = names;
+        archive->size = archive->size * 2 + 16;
+    }
+    archive->names[archive->count++] = name;
+    return 0;
+}
+
 static int
-extractDependencyFromArchive(ARCHIVE_STATUS *status, const char *filename)
+_compare_names(const void *a, const void *b)
 {
+    return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+/*
+ * Extract the files collected for 'archive' in one pass over its TOC.
+ */
+static int
+_extract_archive_dependencies(DEPENDENCY_ARCHIVE *archive)
+{
+    ARCHIVE_STATUS *status = archive->status;
     TOC * ptoc = status->tocbuff;
+    const char *name;
+
+    VS("LOADER: Extracting %d dependencies from archive %s\n",
+       (int) archive->count, status->archivename);
 
-    VS("LOADER: Extracting dependencies from archive\n");
+    qsort(archive->names, archive->count, sizeof(char *), _compare_names);
 
     while (ptoc < status->tocend) {
-        if (strcmp(ptoc->name, filename) == 0) {
+        name = ptoc->name;
+
+        if (bsearch(&name, archive->names, archive->count, sizeof(char *),
+                    _compare_names) != NULL) {
             if (pyi_arch_extract2fs(status, ptoc)) {
+                FATALERROR("Error extracting %s\n", ptoc->name);
                 return -1;
             }
         }
@@ -192,26 +266,49 @@ extractDependencyFromArchive(ARCHIVE_STATUS *status, const char *filename)
     return 0;
 }
 
-/* Decide if the dependency identified by item is in a onedir or onfile archive
- * then call the appropriate function.
+/* Free the archives opened for dependencies. */
+static void
+_free_dependencies(DEPENDENCIES *deps)
+{
+    size_t index;
+
+    for (index = 0; index < deps->count; index++) {
+        pyi_arch_status_free_memory(deps->archives[index].status);
+        free(deps->archives[index].names);
+    }
+    free(deps->archives);
+}
+
+/* Decide if the dependency identified by item (in the form path:filename)
+ * is in a onedir or onefile archive. Files in a onedir directory are copied
+ * right away, files in another archive are added to the archive's list.
  */
 static int
-_extract_dependency(ARCHIVE_STATUS *archive_pool[], const char *item)
+_extract_dependency(ARCHIVE_STATUS *archive_status, DEPENDENCIES *deps,
+                    const char *item)
 {
-    ARCHIVE_STATUS *status = NULL;
-    ARCHIVE_STATUS *archive_status = archive_pool[0];
+    DEPENDENCY_ARCHIVE *archive;
+    const char *filename;
     char path[PATH_MAX];
-    char filename[PATH_MAX];
     char srcpath[PATH_MAX];
-    char archive_path[PATH_MAX];
-
     char dirname[PATH_MAX];
+    size_t len;
 
-    VS("LOADER: Extracting dependencies\n");
+    filename = strchr(item, ':');
 
-    if (splitName(path, filename, item) == -1) {
+    if (filename == NULL || filename == item || filename[1] == '\0') {
+        FATALERROR("Invalid dependency %s\n", item);
         return -1;
     }
+    len = filename - item;
+    filename++;
+
+    if (len >= PATH_MAX) {
+        FATALERROR("Dependency path exceeds PATH_MAX\n");
+        return -1;
+    }
+    memcpy(path, item, len);
+    path[len] = '\0';
 
     pyi_path_dirname(dirname, path);
 
@@ -220,54 +317,96 @@ _extract_dependency(ARCHIVE_STATUS *archive_pool[], const char *item)
      * archive next to the current onedir archive, 3) dependencies are in a onefile
      * archive next to the current onefile archive.
      */
-    VS("LOADER: Checking if file exists\n");
 
     /* TODO implement pyi_path_join to accept variable length of arguments for this case. */
     if (checkFile(srcpath, "%s%s%s%s%s", archive_status->homepath, PYI_SEPSTR, dirname,
-                  PYI_SEPSTR, filename) == 0) {
+                  PYI_SEPSTR, filename) == 0 ||
+        checkFile(srcpath, "%s%s%s%s%s%s%s", archive_status->homepath, PYI_SEPSTR,
+                  "..", PYI_SEPSTR, dirname, PYI_SEPSTR, filename) == 0) {
         VS("LOADER: File %s found, assuming is onedir\n", srcpath);
 
         if (copyDependencyFromDir(archive_status, srcpath, filename) == -1) {
             FATALERROR("Error copying %s\n", filename);
             return -1;
         }
-        /* TODO implement pyi_path_join to accept variable length of arguments for this case. */
+        return 0;
     }
-    else if (checkFile(srcpath, "%s%s%s%s%s%s%s", archive_status->homepath, PYI_SEPSTR,
-                       "..", PYI_SEPSTR, dirname, PYI_SEPSTR, filename) == 0) {
-        VS("LOADER: File %s found, assuming is onedir\n", srcpath);
 
-        if (copyDependencyFromDir(archive_status, srcpath, filename) == -1) {
-            FATALERROR("Error copying %s\n", filename);
-            return -1;
-        }
+    if ((archive = _get_archive(archive_status, deps, path, len)) == NULL) {
+        return -1;
     }
-    else {
-        VS("LOADER: File %s not found, assuming is onefile.\n", srcpath);
-
-        /* TODO implement pyi_path_join to accept variable length of arguments for this case. */
-        if ((checkFile(archive_path, "%s%s%s.pkg", archive_status->homepath, PYI_SEPSTR,
-                       path) != 0) &&
-            (checkFile(archive_path, "%s%s%s.exe", archive_status->homepath, PYI_SEPSTR,
-                       path) != 0) &&
-            (checkFile(archive_path, "%s%s%s", archive_status->homepath, PYI_SEPSTR,
-                       path) != 0)) {
-            FATALERROR("Archive not found: %s\n", archive_path);
-            return -1;
-        }
+    return _add_archive_dependency(archive, filename);
+}
 
-        if ((status = _get_archive(archive_pool, archive_path)) == NULL) {
-            FATALERROR("Archive not found: %s\n", archive_path);
-            return -1;
+/*
+ * Pipelined extraction (onefile, runtime option pyi-pipelined-extraction).
+ *
+ * Only the files needed to bring up the interpreter are extracted before the
+ * child process is started: binaries in the top-level directory (the Python
+ * library, shared libraries and the extension modules used during bootstrap),
+ * zipped eggs, Python modules added as data files and distribution metadata.
+ * Binaries inside packages and the other data files are extracted by the
+ * parent while the child starts Python. The child waits for them when they
+ * are needed, see PendingExtraction in pyimod03_importers.
+ */
+int
+pyi_launch_is_pipelined(const ARCHIVE_STATUS *archive_status)
+{
+#ifdef _WIN32
+    return false;
+#else
+    return pyi_arch_get_option(archive_status, "pyi-pipelined-extraction") != NULL;
+#endif
+}
+
+/*
+ * Return non zero if the data file 'name' may be imported or is looked up
+ * by directory listings without opening it: Python modules and the files
+ * in distribution metadata directories (*.dist-info, *.egg-info).
+ */
+static int
+_is_eager_data(const char *name)
+{
+    const char *suffixes[] = { ".py", ".pyc", ".pyo" };
+    const char *dirs[] = { ".dist-info", ".egg-info" };
+    const char *p;
+    size_t len = strlen(name);
+    size_t i, n;
+
+    for (i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        n = strlen(suffixes[i]);
+
+        if (len >= n && strcmp(name + len - n, suffixes[i]) == 0) {
+            return 1;
         }
+    }
 
-        if (extractDependencyFromArchive(status, filename) == -1) {
-            FATALERROR("Error extracting %s\n", filename);
-            free(status);
-            return -1;
+    for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        n = strlen(dirs[i]);
+
+        for (p = strstr(name, dirs[i]); p != NULL; p = strstr(p + 1, dirs[i])) {
+            /* Must end a path component, e.g. foo.dist-info/METADATA. */
+            if (p[n] == PYI_SEP || p[n] == '\0') {
+                return 1;
+            }
         }
     }
+    return 0;
+}
 
+/*
+ * Return the type code of an entry whose extraction is deferred in pipelined
+ * mode, or 0 if the entry is extracted before the child is started.
+ */
+static char
+_deferred_type(const TOC *ptoc)
+{
+    if (ptoc->typcd == ARCHIVE_ITEM_BINARY && strchr(ptoc->name, PYI_SEP) != NULL) {
+        return ARCHIVE_ITEM_BINARY;
+    }
+    if (ptoc->typcd == ARCHIVE_ITEM_DATA && !_is_eager_data(ptoc->name)) {
+        return ARCHIVE_ITEM_DATA;
+    }
     return 0;
 }
 
@@ -306,25 +445,41 @@ int
 pyi_launch_extract_binaries(ARCHIVE_STATUS *archive_status)
 {
     int retcode = 0;
-    ptrdiff_t index = 0;
+    size_t index = 0;
+    int pipelined = pyi_launch_is_pipelined(archive_status);
 
-    /*
-     * archive_pool[0] is reserved for the main process, the others for dependencies.
-     */
-    ARCHIVE_STATUS *archive_pool[_MAX_ARCHIVE_POOL_LEN];
+    /* Other archives that dependencies are extracted from. */
+    DEPENDENCIES deps;
     TOC * ptoc = archive_status->tocbuff;
+#ifdef PYI_HAVE_URING
+    /* Batch the writes if the kernel supports io_uring. */
+    PYI_URING *ring = pyi_uring_new();
+#endif
 
-    /* Clean memory for archive_pool list. */
-    memset(&archive_pool, 0, _MAX_ARCHIVE_POOL_LEN * sizeof(ARCHIVE_STATUS *));
+    memset(&deps, 0, sizeof(deps));
 
-    /* Current process is the 1st item. */
-    archive_pool[0] = archive_status;
+    /* Allocate the read and output buffers once for all files. */
+    if (pyi_arch_init_buffers(archive_status)) {
+        return -1;
+    }
 
     VS("LOADER: Extracting binaries\n");
 
     while (ptoc < archive_status->tocend) {
-        if (ptoc->typcd == ARCHIVE_ITEM_BINARY || ptoc->typcd == ARCHIVE_ITEM_DATA ||
-            ptoc->typcd == ARCHIVE_ITEM_ZIPFILE) {
+        if (pipelined && _deferred_type(ptoc)) {
+            /* Extracted by pyi_launch_extract_deferred(). */
+        }
+        else if (ptoc->typcd == ARCHIVE_ITEM_BINARY || ptoc->typcd == ARCHIVE_ITEM_DATA ||
+                 ptoc->typcd == ARCHIVE_ITEM_ZIPFILE) {
+#ifdef PYI_HAVE_URING
+            if (ring != NULL) {
+                if (pyi_uring_extract2fs(ring, archive_status, ptoc)) {
+                    retcode = -1;
+                    break;
+                }
+            }
+            else
+#endif
             if (pyi_arch_extract2fs(archive_status, ptoc)) {
                 retcode = -1;
                 break;  /* No need to extract other items in case of error. */
@@ -334,7 +489,7 @@ pyi_launch_extract_binaries(ARCHIVE_STATUS *archive_status)
         else {
             /* 'Multipackage' feature - dependency is stored in different executables. */
             if (ptoc->typcd == ARCHIVE_ITEM_DEPENDENCY) {
-                if (_extract_dependency(archive_pool, ptoc->name) == -1) {
+                if (_extract_dependency(archive_status, &deps, ptoc->name) == -1) {
                     retcode = -1;
                     break;  /* No need to extract other items in case of error. */
                 }
@@ -344,28 +499,247 @@ pyi_launch_extract_binaries(ARCHIVE_STATUS *archive_status)
         ptoc = pyi_arch_increment_toc_ptr(archive_status, ptoc);
     }
 
-    /*
-     * Free memory allocated for archive_pool data. Do not free memory
-     * of the main process - start with 2nd item.
-     */
-    for (index = 1; archive_pool[index] != NULL; index++) {
-        pyi_arch_status_free_memory(archive_pool[index]);
+#ifdef PYI_HAVE_URING
+    /* Wait until the queued files are written. */
+    if (ring != NULL && pyi_uring_finish(ring)) {
+        retcode = -1;
+    }
+#endif
+
+    /* Extract the dependencies found in other archives. */
+    for (index = 0; retcode == 0 && index < deps.count; index++) {
+        retcode = _extract_archive_dependencies(&deps.archives[index]);
+    }
+    _free_dependencies(&deps);
+
+    /* In pipelined mode the buffers are reused by pyi_launch_extract_deferred(). */
+    if (!pipelined) {
+        pyi_arch_free_buffers(archive_status);
     }
 
     return retcode;
 }
 
+#ifndef _WIN32
+
 /*
- * Run scripts
- * Return non zero on failure
+ * Extract the entries skipped by pyi_launch_extract_binaries() in pipelined
+ * mode: binaries first, because any extension import in the child waits for
+ * all of them, then data files. Each file is renamed into place once it is
+ * complete. Extraction stops early if the child exits. On failure a marker
+ * file is left in the temporary directory so that the child stops waiting
+ * for files that will never appear.
  */
 int
-pyi_launch_run_scripts(ARCHIVE_STATUS *status)
+pyi_launch_extract_deferred(ARCHIVE_STATUS *archive_status)
+{
+    const char types[] = { ARCHIVE_ITEM_BINARY, ARCHIVE_ITEM_DATA };
+    char marker[PATH_MAX];
+    FILE *fp;
+    TOC * ptoc;
+    size_t i;
+
+    VS("LOADER: Extracting deferred files\n");
+
+    for (i = 0; i < sizeof(types); i++) {
+        ptoc = archive_status->tocbuff;
+
+        while (ptoc < archive_status->tocend) {
+            if (_deferred_type(ptoc) == types[i]) {
+                /* Nobody is waiting for the rest when the child is gone. */
+                if (pyi_utils_child_exited()) {
+                    VS("LOADER: Child exited, stopping extraction\n");
+                    return 0;
+                }
+                if (pyi_arch_extract2fs_rename(archive_status, ptoc)) {
+                    goto failed;
+                }
+            }
+            ptoc = pyi_arch_increment_toc_ptr(archive_status, ptoc);
+        }
+    }
+    return 0;
+
+failed:
+    if (snprintf(marker, PATH_MAX, "%s%s%s", archive_status->temppath, PYI_SEPSTR,
+                 PYI_EXTRACTION_FAILED_MARKER) < PATH_MAX) {
+        fp = pyi_path_fopen(marker, "wb");
+
+        if (fp != NULL) {
+            fclose(fp);
+        }
+    }
+    return -1;
+}
+
+/*
+ * Tell the bootstrap code in the child which files the parent may still be
+ * extracting: sys._pyi_pending_extraction = ([binaries], [data files]).
+ * Names are relative to sys._MEIPASS, in extraction order.
+ */
+static int
+_set_pending_extraction(ARCHIVE_STATUS *status)
+{
+    PyObject *binaries;
+    PyObject *datas;
+    PyObject *name;
+    PyObject *pending;
+    TOC * ptoc = status->tocbuff;
+    char typcd;
+
+    if (is_py2 || !status->has_temp_directory || !pyi_launch_is_pipelined(status)) {
+        return 0;
+    }
+
+    VS("LOADER: setting sys._pyi_pending_extraction\n");
+
+    binaries = PI_PyList_New(0);
+    datas = PI_PyList_New(0);
+
+    if (binaries == NULL || datas == NULL) {
+        return -1;
+    }
+
+    while (ptoc < status->tocend) {
+        typcd = _deferred_type(ptoc);
+
+        if (typcd) {
+            name = PI_PyUnicode_DecodeFSDefault(ptoc->name);
+
+            if (name == NULL ||
+                PI_PyList_Append(typcd == ARCHIVE_ITEM_BINARY ? binaries : datas,
+                                 name) < 0) {
+                return -1;
+            }
+            PI_Py_DecRef(name);
+        }
+        ptoc = pyi_arch_increment_toc_ptr(status, ptoc);
+    }
+
+    pending = PI_Py_BuildValue("(NN)", binaries, datas);
+
+    if (pending == NULL || PI_PySys_SetObject("_pyi_pending_extraction", pending) < 0) {
+        return -1;
+    }
+    PI_Py_DecRef(pending);
+    return 0;
+}
+
+#endif /* ifndef _WIN32 */
+
+/*
+ * Return non zero if 'name' is one of the comma-separated names in 'list'.
+ */
+static int
+_in_list(const char *list, const char *name, size_t len)
+{
+    const char *end;
+
+    while (*list) {
+        end = strchr(list, ',');
+
+        if ((end ? (size_t) (end - list) : strlen(list)) == len &&
+            strncmp(list, name, len) == 0) {
+            return 1;
+        }
+
+        if (!end) {
+            break;
+        }
+        list = end + 1;
+    }
+    return 0;
+}
+
+/*
+ * Return the name of the script 'name' (of length 'len') in the TOC, or NULL.
+ */
+static const char *
+_find_entrypoint(const ARCHIVE_STATUS *status, const char *list,
+                 const char *name, size_t len)
+{
+    TOC *ptoc = status->tocbuff;
+
+    if (!_in_list(list, name, len)) {
+        return NULL;
+    }
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd == ARCHIVE_ITEM_PYSOURCE &&
+            strncmp(ptoc->name, name, len) == 0 && ptoc->name[len] == '\0') {
+            return ptoc->name;
+        }
+    }
+    return NULL;
+}
+
+int
+pyi_launch_select_entrypoint(ARCHIVE_STATUS *status)
+{
+    char *list = pyi_arch_get_option(status, "pyi-entrypoints");
+    const char *name;
+    const char *sep;
+    size_t len;
+
+    if (list == NULL) {
+        return 0;
+    }
+
+    /* Program name: base name of argv[0], without .exe on Windows. */
+    name = status->argv[0];
+
+    if ((sep = strrchr(name, PYI_SEP)) != NULL) {
+        name = sep + 1;
+    }
+#ifdef _WIN32
+
+    if ((sep = strrchr(name, '/')) != NULL) {
+        name = sep + 1;
+    }
+#endif
+    len = strlen(name);
+#ifdef _WIN32
+
+    if (len > 4 && stricmp(name + len - 4, ".exe") == 0) {
+        len -= 4;
+    }
+#endif
+    status->entrypoint = _find_entrypoint(status, list, name, len);
+
+    if (status->entrypoint == NULL && status->argc > 1) {
+        status->entrypoint = _find_entrypoint(status, list, status->argv[1],
+                                              strlen(status->argv[1]));
+
+        if (status->entrypoint != NULL) {
+            /* "prog cmd args" runs as "cmd args". */
+            status->argc--;
+            status->argv++;
+        }
+    }
+
+    if (status->entrypoint == NULL) {
+        FATALERROR("Usage: %.*s COMMAND [ARGS...]\n"
+                   "where COMMAND is one of: %s\n", (int) len, name, list);
+        return -1;
+    }
+    VS("LOADER: Entry point is %s\n", status->entrypoint);
+    return 0;
+}
+
+/*
+ * Run the scripts starting at *pptoc, up to and including the one named
+ * 'last' (or all of them if 'last' is NULL), and advance *pptoc past them.
+ * Return non zero on failure
+ */
+static int
+_run_scripts(ARCHIVE_STATUS *status, TOC **pptoc, const char *last)
 {
     unsigned char *data;
     char buf[PATH_MAX];
     size_t namelen;
-    TOC * ptoc = status->tocbuff;
+    TOC * ptoc = *pptoc;
+    /* Of several entry points, only status->entrypoint is run. */
+    char *entrypoints = pyi_arch_get_option(status, "pyi-entrypoints");
     PyObject *__main__;
     PyObject *__file__;
     PyObject *main_dict;
@@ -387,9 +761,16 @@ pyi_launch_run_scripts(ARCHIVE_STATUS *status)
 
     /* Iterate through toc looking for scripts (type 's') */
     while (ptoc < status->tocend) {
-        if (ptoc->typcd == ARCHIVE_ITEM_PYSOURCE) {
+        if (ptoc->typcd == ARCHIVE_ITEM_PYSOURCE &&
+            (entrypoints == NULL || ptoc->name == status->entrypoint ||
+             !_in_list(entrypoints, ptoc->name, strlen(ptoc->name)))) {
             /* Get data out of the archive.  */
             data = pyi_arch_extract(status, ptoc);
+
+            if (data == NULL) {
+                FATALERROR("Failed to extract %s\n", ptoc->name);
+                return -1;
+            }
             /* Set the __file__ attribute within the __main__ module,
              *  for full compatibility with normal execution. */
             namelen = strnlen(ptoc->name, PATH_MAX);
@@ -433,13 +814,65 @@ pyi_launch_run_scripts(ARCHIVE_STATUS *status)
                 return -1;
             }
             free(data);
+
+            if (last != NULL && strcmp(ptoc->name, last) == 0) {
+                ptoc = pyi_arch_increment_toc_ptr(status, ptoc);
+                break;
+            }
         }
 
         ptoc = pyi_arch_increment_toc_ptr(status, ptoc);
     }
+    *pptoc = ptoc;
     return 0;
 }
 
+/*
+ * Run scripts
+ * Return non zero on failure
+ */
+int
+pyi_launch_run_scripts(ARCHIVE_STATUS *status)
+{
+    TOC * ptoc = status->tocbuff;
+
+    return _run_scripts(status, &ptoc, NULL);
+}
+
+#ifndef _WIN32
+
+/*
+ * Zygote server: run the bootstrap script, which installs the importers,
+ * and serve requests. The other scripts (runtime hooks and the application)
+ * run in the forked workers.
+ */
+static int
+_zygote_serve(ARCHIVE_STATUS *status)
+{
+    TOC * ptoc = status->tocbuff;
+
+    if (_run_scripts(status, &ptoc, "pyiboot01_bootstrap")) {
+        return -1;
+    }
+
+    if (pyi_zygote_serve(status) == 0) {
+        /* The server is done. */
+        return 0;
+    }
+
+    if (pyi_launch_select_entrypoint(status)) {
+        return -1;
+    }
+
+    if (pyi_zygote_init_worker(status)) {
+        FATALERROR("Failed to set up zygote worker\n");
+        return -1;
+    }
+    return _run_scripts(status, &ptoc, NULL);
+}
+
+#endif /* ifndef _WIN32 */
+
 /*
  * call a simple "int func(void)" entry point.  Assumes such a function
  * exists in the main namespace.
@@ -541,6 +974,21 @@ pyi_launch_execute(ARCHIVE_STATUS *status)
         return -1;
     }
 
+    /* Let the bootstrap code decrypt the PYZ archives without PyCrypto. */
+    if (pyi_aes_install()) {
+        FATALERROR("Failed to set sys._pyi_aes_cfb128_decrypt\n");
+        return -1;
+    }
+
+#ifndef _WIN32
+
+    /* Let the bootstrap code wait for files still being extracted. */
+    if (_set_pending_extraction(status)) {
+        FATALERROR("Failed to set sys._pyi_pending_extraction\n");
+        return -1;
+    }
+#endif
+
     /* Import core pyinstaller modules from the executable - bootstrap */
     if (pyi_pylib_import_modules(status)) {
         return -1;
@@ -574,6 +1022,13 @@ pyi_launch_execute(ARCHIVE_STATUS *status)
     }
 #endif     /* WIN32 */
 
+#ifndef _WIN32
+
+    if (pyi_zygote_is_server()) {
+        return _zygote_serve(status);
+    }
+#endif
+
     /* Run scripts */
     rc = pyi_launch_run_scripts(status);
 
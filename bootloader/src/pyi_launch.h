@@ -35,6 +35,33 @@ int pyi_launch_extract_binaries(ARCHIVE_STATUS *archive_status);
  */
 int pyi_launch_need_to_extract_binaries(ARCHIVE_STATUS *archive_status);
 
+/*
+ * Check if the archive asks for pipelined extraction: the child process is
+ * started as soon as the files needed to start Python are extracted and the
+ * parent extracts the rest with pyi_launch_extract_deferred().
+ */
+int pyi_launch_is_pipelined(const ARCHIVE_STATUS *archive_status);
+
+#ifndef _WIN32
+/* Created in the temporary directory when deferred extraction failed. */
+#define PYI_EXTRACTION_FAILED_MARKER ".pyi-extraction-failed"
+
+/*
+ * Extract the files deferred in pipelined mode.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+int pyi_launch_extract_deferred(ARCHIVE_STATUS *archive_status);
+#endif
+
+/*
+ * If the executable has several entry points (pyi-entrypoints option),
+ * select the script to run from the name the executable was started as or,
+ * failing that, from the first argument, which is then dropped from argv.
+ * Return non zero if no entry point matches.
+ */
+int pyi_launch_select_entrypoint(ARCHIVE_STATUS *archive_status);
+
 /*
  * Wrapped platform specific initialization before loading Python and executing
  * all scripts in the archive.
@@ -24,6 +24,9 @@
 #include <stdio.h>  /* FILE */
 #include <stdlib.h> /* calloc */
 #include <string.h> /* memset */
+#ifdef __GLIBC__
+    #include <malloc.h> /* malloc_trim */
+#endif
 
 /* PyInstaller headers. */
 #include "pyi_global.h"  /* PATH_MAX for win32 */
@@ -32,6 +35,8 @@
 #include "pyi_utils.h"
 #include "pyi_pythonlib.h"
 #include "pyi_launch.h"
+#include "pyi_zygote.h"
+#include "pyi_readahead.h"
 #include "pyi_win32_utils.h"
 
 int
@@ -42,6 +47,9 @@ pyi_main(int argc, char * argv[])
     char executable[PATH_MAX];
     char homepath[PATH_MAX];
     char archivefile[PATH_MAX];
+    char temppath[PATH_MAX];
+    bool has_temp_directory = false;
+    bool detached_cleanup = false;
     int rc = 0;
     char *extractionpath = NULL;
     wchar_t * dllpath_w;
@@ -102,6 +110,34 @@ pyi_main(int argc, char * argv[])
     archive_status->argc = argc;
     archive_status->argv = argv;
 
+    /*
+     * Select the script to run early, so that an unknown command fails
+     * before anything is extracted. The parent passes the original argv to
+     * the child. The zygote server selects the entry point for each worker.
+     */
+#ifndef _WIN32
+    if (!pyi_zygote_is_server())
+#endif
+    {
+        if (pyi_launch_select_entrypoint(archive_status)) {
+            pyi_arch_status_free_memory(archive_status);
+            return -1;
+        }
+    }
+
+#ifndef _WIN32
+
+    /* Run in a fork of a warm interpreter if a zygote server is running. */
+    if (!extractionpath && pyi_zygote_is_enabled(archive_status) &&
+        !pyi_zygote_is_server()) {
+        if (pyi_zygote_run(executable, argc, argv, &rc) == 0) {
+            pyi_arch_status_free_memory(archive_status);
+            return rc;
+        }
+        pyi_zygote_start_server(executable);
+    }
+#endif
+
 #if defined(_WIN32) || defined(__APPLE__)
 
     /* On Windows and Mac use single-process for --onedir mode. */
@@ -110,6 +146,20 @@ pyi_main(int argc, char * argv[])
         extractionpath = homepath;
     }
 
+#elif defined(__linux__)
+
+    /*
+     * On Linux use single-process for --onedir mode only if the collected
+     * binaries were built with a RUNPATH relative to $ORIGIN, otherwise the
+     * child has to be started with LD_LIBRARY_PATH set.
+     */
+    if (!extractionpath &&
+        pyi_arch_get_option(archive_status, "pyi-linux-single-process") != NULL &&
+        !pyi_launch_need_to_extract_binaries(archive_status)) {
+        VS("LOADER: Binaries have RUNPATH set; setting extractionpath to homepath\n");
+        extractionpath = homepath;
+    }
+
 #endif
 
 #ifdef _WIN32
@@ -143,6 +193,11 @@ pyi_main(int argc, char * argv[])
             strcpy(archive_status->mainpath, archive_status->temppath);
         }
 
+#ifndef _WIN32
+        /* Fill the page cache while Python is being initialized. */
+        pyi_readahead_start(archive_status);
+#endif
+
         /* Main code to initialize Python and run user's code. */
         pyi_launch_initialize(archive_status);
         rc = pyi_launch_execute(archive_status);
@@ -175,16 +230,53 @@ pyi_main(int argc, char * argv[])
         pyi_parent_to_background();
 
         /* Run user's code in a subprocess and pass command line arguments to it. */
-        rc = pyi_utils_create_child(executable, archive_status, argc, argv);
+        if (pyi_utils_spawn_child(executable, archive_status, argc, argv) != 0) {
+            VS("LOADER: exiting early\n");
+            rc = 1;
+        }
+        else {
+#ifndef _WIN32
+            /* Extract the remaining files while the child starts Python. */
+            if (pyi_launch_is_pipelined(archive_status) &&
+                pyi_launch_extract_deferred(archive_status)) {
+                VS("LOADER: Error extracting deferred files\n");
+            }
+#endif
+            /*
+             * From now on the parent only forwards signals and removes the
+             * temporary directory, so release the archive before waiting.
+             */
+            has_temp_directory = archive_status->has_temp_directory;
+            detached_cleanup = pyi_arch_get_option(archive_status,
+                                                   "pyi-detached-cleanup") != NULL;
+            strcpy(temppath, archive_status->temppath);
+            pyi_arch_status_free_memory(archive_status);
+            archive_status = NULL;
+#ifdef __GLIBC__
+            malloc_trim(0);
+#endif
+            rc = pyi_utils_wait_child();
+        }
 
         VS("LOADER: Back to parent (RC: %d)\n", rc);
 
         VS("LOADER: Doing cleanup\n");
 
-        if (archive_status->has_temp_directory == true) {
-            pyi_remove_temp_path(archive_status->temppath);
+        if (archive_status != NULL) {
+            has_temp_directory = archive_status->has_temp_directory;
+            strcpy(temppath, archive_status->temppath);
+            pyi_arch_status_free_memory(archive_status);
+        }
+
+        if (has_temp_directory == true) {
+#ifndef _WIN32
+            /* Optionally do not make the caller wait for the removal. */
+            if (!detached_cleanup || pyi_remove_temp_path_detached(temppath) != 0)
+#endif
+            {
+                pyi_remove_temp_path(temppath);
+            }
         }
-        pyi_arch_status_free_memory(archive_status);
 
     }
     return rc;
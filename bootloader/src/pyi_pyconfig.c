@@ -0,0 +1,851 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Interpreter initialization with PyPreConfig/PyConfig (Python 3.8+).
+ *
+ * The legacy sequence (Py_SetProgramName, Py_SetPythonHome, Py_SetPath,
+ * Py_Initialize and PySys_SetPath afterwards) lets Python compute its path
+ * configuration, probing the filesystem, only to override the result. Here
+ * all of it is passed in one PyConfig.
+ *
+ * PyConfig is a plain structure whose layout changes with every Python
+ * version, so the layouts of the supported versions are copied below from
+ * Include/cpython/initconfig.h. Fields behind Py_GIL_DISABLED, Py_STATS and
+ * Py_DEBUG are left out; free-threaded builds are not supported and the
+ * other ones only add fields at the end (covered by PYCONFIG_SLACK).
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <limits.h>  /* PATH_MAX */
+#endif
+#include <stddef.h>  /* offsetof */
+#include <stdlib.h>  /* calloc, mbstowcs */
+#include <string.h>
+#include <wchar.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_path.h"
+#include "pyi_archive.h"
+#include "pyi_python.h"
+#include "pyi_pythonlib.h"
+#include "pyi_pyconfig.h"
+#include "pyi_win32_utils.h"
+
+/* Extra bytes allocated after PyConfig for fields of debug builds. */
+#define PYCONFIG_SLACK  64
+
+/* Python 3.8 */
+typedef struct {
+    int _config_init;
+    int isolated;
+    int use_environment;
+    int dev_mode;
+    int install_signal_handlers;
+    int use_hash_seed;
+    unsigned long hash_seed;
+    int faulthandler;
+    int tracemalloc;
+    int import_time;
+    int show_ref_count;
+    int show_alloc_count;
+    int dump_refs;
+    int malloc_stats;
+    wchar_t *filesystem_encoding;
+    wchar_t *filesystem_errors;
+    wchar_t *pycache_prefix;
+    int parse_argv;
+    PyWideStringList argv;
+    wchar_t *program_name;
+    PyWideStringList xoptions;
+    PyWideStringList warnoptions;
+    int site_import;
+    int bytes_warning;
+    int inspect;
+    int interactive;
+    int optimization_level;
+    int parser_debug;
+    int write_bytecode;
+    int verbose;
+    int quiet;
+    int user_site_directory;
+    int configure_c_stdio;
+    int buffered_stdio;
+    wchar_t *stdio_encoding;
+    wchar_t *stdio_errors;
+#ifdef _WIN32
+    int legacy_windows_stdio;
+#endif
+    wchar_t *check_hash_pycs_mode;
+    int pathconfig_warnings;
+    wchar_t *pythonpath_env;
+    wchar_t *home;
+    int module_search_paths_set;
+    PyWideStringList module_search_paths;
+    wchar_t *executable;
+    wchar_t *base_executable;
+    wchar_t *prefix;
+    wchar_t *base_prefix;
+    wchar_t *exec_prefix;
+    wchar_t *base_exec_prefix;
+    int skip_source_first_line;
+    wchar_t *run_command;
+    wchar_t *run_module;
+    wchar_t *run_filename;
+    int _install_importlib;
+    int _init_main;
+} PyConfig_v38;
+
+/* Python 3.9 */
+typedef struct {
+    int _config_init;
+    int isolated;
+    int use_environment;
+    int dev_mode;
+    int install_signal_handlers;
+    int use_hash_seed;
+    unsigned long hash_seed;
+    int faulthandler;
+    int _use_peg_parser;
+    int tracemalloc;
+    int import_time;
+    int show_ref_count;
+    int dump_refs;
+    int malloc_stats;
+    wchar_t *filesystem_encoding;
+    wchar_t *filesystem_errors;
+    wchar_t *pycache_prefix;
+    int parse_argv;
+    PyWideStringList argv;
+    wchar_t *program_name;
+    PyWideStringList xoptions;
+    PyWideStringList warnoptions;
+    int site_import;
+    int bytes_warning;
+    int inspect;
+    int interactive;
+    int optimization_level;
+    int parser_debug;
+    int write_bytecode;
+    int verbose;
+    int quiet;
+    int user_site_directory;
+    int configure_c_stdio;
+    int buffered_stdio;
+    wchar_t *stdio_encoding;
+    wchar_t *stdio_errors;
+#ifdef _WIN32
+    int legacy_windows_stdio;
+#endif
+    wchar_t *check_hash_pycs_mode;
+    int pathconfig_warnings;
+    wchar_t *pythonpath_env;
+    wchar_t *home;
+    int module_search_paths_set;
+    PyWideStringList module_search_paths;
+    wchar_t *executable;
+    wchar_t *base_executable;
+    wchar_t *prefix;
+    wchar_t *base_prefix;
+    wchar_t *exec_prefix;
+    wchar_t *base_exec_prefix;
+    wchar_t *platlibdir;
+    int skip_source_first_line;
+    wchar_t *run_command;
+    wchar_t *run_module;
+    wchar_t *run_filename;
+    int _install_importlib;
+    int _init_main;
+    int _isolated_interpreter;
+    PyWideStringList _orig_argv;
+} PyConfig_v39;
+
+/* Python 3.10 */
+typedef struct {
+    int _config_init;
+    int isolated;
+    int use_environment;
+    int dev_mode;
+    int install_signal_handlers;
+    int use_hash_seed;
+    unsigned long hash_seed;
+    int faulthandler;
+    int tracemalloc;
+    int import_time;
+    int show_ref_count;
+    int dump_refs;
+    int malloc_stats;
+    wchar_t *filesystem_encoding;
+    wchar_t *filesystem_errors;
+    wchar_t *pycache_prefix;
+    int parse_argv;
+    PyWideStringList orig_argv;
+    PyWideStringList argv;
+    PyWideStringList xoptions;
+    PyWideStringList warnoptions;
+    int site_import;
+    int bytes_warning;
+    int warn_default_encoding;
+    int inspect;
+    int interactive;
+    int optimization_level;
+    int parser_debug;
+    int write_bytecode;
+    int verbose;
+    int quiet;
+    int user_site_directory;
+    int configure_c_stdio;
+    int buffered_stdio;
+    wchar_t *stdio_encoding;
+    wchar_t *stdio_errors;
+#ifdef _WIN32
+    int legacy_windows_stdio;
+#endif
+    wchar_t *check_hash_pycs_mode;
+    int pathconfig_warnings;
+    wchar_t *program_name;
+    wchar_t *pythonpath_env;
+    wchar_t *home;
+    wchar_t *platlibdir;
+    int module_search_paths_set;
+    PyWideStringList module_search_paths;
+    wchar_t *executable;
+    wchar_t *base_executable;
+    wchar_t *prefix;
+    wchar_t *base_prefix;
+    wchar_t *exec_prefix;
+    wchar_t *base_exec_prefix;
+    int skip_source_first_line;
+    wchar_t *run_command;
+    wchar_t *run_module;
+    wchar_t *run_filename;
+    int _install_importlib;
+    int _init_main;
+    int _isolated_interpreter;
+} PyConfig_v310;
+
+/* Python 3.11 */
+typedef struct {
+    int _config_init;
+    int isolated;
+    int use_environment;
+    int dev_mode;
+    int install_signal_handlers;
+    int use_hash_seed;
+    unsigned long hash_seed;
+    int faulthandler;
+    int tracemalloc;
+    int import_time;
+    int code_debug_ranges;
+    int show_ref_count;
+    int dump_refs;
+    wchar_t *dump_refs_file;
+    int malloc_stats;
+    wchar_t *filesystem_encoding;
+    wchar_t *filesystem_errors;
+    wchar_t *pycache_prefix;
+    int parse_argv;
+    PyWideStringList orig_argv;
+    PyWideStringList argv;
+    PyWideStringList xoptions;
+    PyWideStringList warnoptions;
+    int site_import;
+    int bytes_warning;
+    int warn_default_encoding;
+    int inspect;
+    int interactive;
+    int optimization_level;
+    int parser_debug;
+    int write_bytecode;
+    int verbose;
+    int quiet;
+    int user_site_directory;
+    int configure_c_stdio;
+    int buffered_stdio;
+    wchar_t *stdio_encoding;
+    wchar_t *stdio_errors;
+#ifdef _WIN32
+    int legacy_windows_stdio;
+#endif
+    wchar_t *check_hash_pycs_mode;
+    int use_frozen_modules;
+    int safe_path;
+    int pathconfig_warnings;
+    wchar_t *program_name;
+    wchar_t *pythonpath_env;
+    wchar_t *home;
+    wchar_t *platlibdir;
+    int module_search_paths_set;
+    PyWideStringList module_search_paths;
+    wchar_t *stdlib_dir;
+    wchar_t *executable;
+    wchar_t *base_executable;
+    wchar_t *prefix;
+    wchar_t *base_prefix;
+    wchar_t *exec_prefix;
+    wchar_t *base_exec_prefix;
+    int skip_source_first_line;
+    wchar_t *run_command;
+    wchar_t *run_module;
+    wchar_t *run_filename;
+    int _install_importlib;
+    int _init_main;
+    int _isolated_interpreter;
+    int _is_python_build;
+} PyConfig_v311;
+
+/* Python 3.12 */
+typedef struct {
+    int _config_init;
+    int isolated;
+    int use_environment;
+    int dev_mode;
+    int install_signal_handlers;
+    int use_hash_seed;
+    unsigned long hash_seed;
+    int faulthandler;
+    int tracemalloc;
+    int perf_profiling;
+    int import_time;
+    int code_debug_ranges;
+    int show_ref_count;
+    int dump_refs;
+    wchar_t *dump_refs_file;
+    int malloc_stats;
+    wchar_t *filesystem_encoding;
+    wchar_t *filesystem_errors;
+    wchar_t *pycache_prefix;
+    int parse_argv;
+    PyWideStringList orig_argv;
+    PyWideStringList argv;
+    PyWideStringList xoptions;
+    PyWideStringList warnoptions;
+    int site_import;
+    int bytes_warning;
+    int warn_default_encoding;
+    int inspect;
+    int interactive;
+    int optimization_level;
+    int parser_debug;
+    int write_bytecode;
+    int verbose;
+    int quiet;
+    int user_site_directory;
+    int configure_c_stdio;
+    int buffered_stdio;
+    wchar_t *stdio_encoding;
+    wchar_t *stdio_errors;
+#ifdef _WIN32
+    int legacy_windows_stdio;
+#endif
+    wchar_t *check_hash_pycs_mode;
+    int use_frozen_modules;
+    int safe_path;
+    int int_max_str_digits;
+    int pathconfig_warnings;
+    wchar_t *program_name;
+    wchar_t *pythonpath_env;
+    wchar_t *home;
+    wchar_t *platlibdir;
+    int module_search_paths_set;
+    PyWideStringList module_search_paths;
+    wchar_t *stdlib_dir;
+    wchar_t *executable;
+    wchar_t *base_executable;
+    wchar_t *prefix;
+    wchar_t *base_prefix;
+    wchar_t *exec_prefix;
+    wchar_t *base_exec_prefix;
+    int skip_source_first_line;
+    wchar_t *run_command;
+    wchar_t *run_module;
+    wchar_t *run_filename;
+    int _install_importlib;
+    int _init_main;
+    int _is_python_build;
+} PyConfig_v312;
+
+/* Python 3.13 */
+typedef struct {
+    int _config_init;
+    int isolated;
+    int use_environment;
+    int dev_mode;
+    int install_signal_handlers;
+    int use_hash_seed;
+    unsigned long hash_seed;
+    int faulthandler;
+    int tracemalloc;
+    int perf_profiling;
+    int import_time;
+    int code_debug_ranges;
+    int show_ref_count;
+    int dump_refs;
+    wchar_t *dump_refs_file;
+    int malloc_stats;
+    wchar_t *filesystem_encoding;
+    wchar_t *filesystem_errors;
+    wchar_t *pycache_prefix;
+    int parse_argv;
+    PyWideStringList orig_argv;
+    PyWideStringList argv;
+    PyWideStringList xoptions;
+    PyWideStringList warnoptions;
+    int site_import;
+    int bytes_warning;
+    int warn_default_encoding;
+    int inspect;
+    int interactive;
+    int optimization_level;
+    int parser_debug;
+    int write_bytecode;
+    int verbose;
+    int quiet;
+    int user_site_directory;
+    int configure_c_stdio;
+    int buffered_stdio;
+    wchar_t *stdio_encoding;
+    wchar_t *stdio_errors;
+#ifdef _WIN32
+    int legacy_windows_stdio;
+#endif
+    wchar_t *check_hash_pycs_mode;
+    int use_frozen_modules;
+    int safe_path;
+    int int_max_str_digits;
+    int cpu_count;
+    int pathconfig_warnings;
+    wchar_t *program_name;
+    wchar_t *pythonpath_env;
+    wchar_t *home;
+    wchar_t *platlibdir;
+    int module_search_paths_set;
+    PyWideStringList module_search_paths;
+    wchar_t *stdlib_dir;
+    wchar_t *executable;
+    wchar_t *base_executable;
+    wchar_t *prefix;
+    wchar_t *base_prefix;
+    wchar_t *exec_prefix;
+    wchar_t *base_exec_prefix;
+    int skip_source_first_line;
+    wchar_t *run_command;
+    wchar_t *run_module;
+    wchar_t *run_filename;
+    wchar_t *sys_path_0;
+    int _install_importlib;
+    int _init_main;
+    int _is_python_build;
+} PyConfig_v313;
+
+/*
+ * Offsets of the PyConfig fields used by the bootloader. 'stdlib_dir' is 0
+ * before Python 3.11.
+ */
+typedef struct _pyconfig_layout {
+    int    pyvers;
+    size_t size;
+    size_t isolated;
+    size_t use_environment;
+    size_t install_signal_handlers;
+    size_t use_hash_seed;
+    size_t hash_seed;
+    size_t parse_argv;
+    size_t argv;
+    size_t warnoptions;
+    size_t site_import;
+    size_t optimization_level;
+    size_t write_bytecode;
+    size_t verbose;
+    size_t user_site_directory;
+    size_t configure_c_stdio;
+    size_t buffered_stdio;
+    size_t pathconfig_warnings;
+    size_t program_name;
+    size_t home;
+    size_t module_search_paths_set;
+    size_t module_search_paths;
+    size_t executable;
+    size_t base_executable;
+    size_t prefix;
+    size_t base_prefix;
+    size_t exec_prefix;
+    size_t base_exec_prefix;
+    size_t stdlib_dir;
+} PYCONFIG_LAYOUT;
+
+#define PYCONFIG_LAYOUT_OF(T) \
+    sizeof(T), \
+    offsetof(T, isolated), \
+    offsetof(T, use_environment), \
+    offsetof(T, install_signal_handlers), \
+    offsetof(T, use_hash_seed), \
+    offsetof(T, hash_seed), \
+    offsetof(T, parse_argv), \
+    offsetof(T, argv), \
+    offsetof(T, warnoptions), \
+    offsetof(T, site_import), \
+    offsetof(T, optimization_level), \
+    offsetof(T, write_bytecode), \
+    offsetof(T, verbose), \
+    offsetof(T, user_site_directory), \
+    offsetof(T, configure_c_stdio), \
+    offsetof(T, buffered_stdio), \
+    offsetof(T, pathconfig_warnings), \
+    offsetof(T, program_name), \
+    offsetof(T, home), \
+    offsetof(T, module_search_paths_set), \
+    offsetof(T, module_search_paths), \
+    offsetof(T, executable), \
+    offsetof(T, base_executable), \
+    offsetof(T, prefix), \
+    offsetof(T, base_prefix), \
+    offsetof(T, exec_prefix), \
+    offsetof(T, base_exec_prefix)
+
+/*
+ * 'pyvers' is stored in the archive cookie as major * 10 + minor, so that
+ * Python 3.10 is 40, 3.11 is 41 and so on.
+ */
+static const PYCONFIG_LAYOUT pyconfig_layouts[] = {
+    {38, PYCONFIG_LAYOUT_OF(PyConfig_v38), 0},
+    {39, PYCONFIG_LAYOUT_OF(PyConfig_v39), 0},
+    {40, PYCONFIG_LAYOUT_OF(PyConfig_v310), 0},
+    {41, PYCONFIG_LAYOUT_OF(PyConfig_v311), offsetof(PyConfig_v311, stdlib_dir)},
+    {42, PYCONFIG_LAYOUT_OF(PyConfig_v312), offsetof(PyConfig_v312, stdlib_dir)},
+    {43, PYCONFIG_LAYOUT_OF(PyConfig_v313), offsetof(PyConfig_v313, stdlib_dir)},
+};
+
+/* Access a field of 'config' through its offset in 'layout'. */
+#define CONFIG_FIELD(config, layout, field, type) \
+    ((type *)((char *)(config) + (layout)->field))
+#define CONFIG_INT(config, layout, field) \
+    (*CONFIG_FIELD(config, layout, field, int))
+
+static const PYCONFIG_LAYOUT *
+_get_layout(void)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(pyconfig_layouts) / sizeof(pyconfig_layouts[0]); i++) {
+        if (pyconfig_layouts[i].pyvers == pyvers) {
+            return &pyconfig_layouts[i];
+        }
+    }
+    return NULL;
+}
+
+int
+pyi_pyconfig_is_supported(void)
+{
+    return _get_layout() != NULL &&
+           PI_PyPreConfig_InitPythonConfig && PI_Py_PreInitialize &&
+           PI_PyConfig_InitIsolatedConfig && PI_PyConfig_Clear &&
+           PI_PyConfig_SetString && PI_PyConfig_SetArgv &&
+           PI_PyWideStringList_Append && PI_Py_InitializeFromConfig &&
+           PI_PyStatus_Exception;
+}
+
+/* Report a failed PyStatus; return non-zero if 'status' is an exception. */
+static int
+_check_status(PyStatus status, const char *what)
+{
+    if (!PI_PyStatus_Exception(status)) {
+        return 0;
+    }
+
+    if (status.err_msg) {
+        FATALERROR("Failed to %s: %s (%s)\n", what, status.err_msg,
+                   status.func ? status.func : "?");
+    }
+    else {
+        FATALERROR("Failed to %s (exit code %d)\n", what, status.exitcode);
+    }
+    return -1;
+}
+
+/* Decode 'value' like pyi_pylib_start_python() does. */
+static int
+_decode(wchar_t *dst, const char *value, const char *what)
+{
+    /* pyi_locale_char2wchar() does not always terminate 'dst'. */
+    memset(dst, 0, (PATH_MAX + 1) * sizeof(wchar_t));
+
+    if (!pyi_locale_char2wchar(dst, (char *)value, PATH_MAX)) {
+        FATALERROR("Failed to convert %s to wchar_t\n", what);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_set_string(PyConfig *config, wchar_t **field, const char *value, const char *what)
+{
+    wchar_t wvalue[PATH_MAX + 1];
+
+    if (_decode(wvalue, value, what)) {
+        return -1;
+    }
+    return _check_status(PI_PyConfig_SetString(config, field, wvalue), "set config string");
+}
+
+static int
+_append(PyWideStringList *list, const char *value, const char *what)
+{
+    wchar_t wvalue[PATH_MAX + 1];
+
+    if (_decode(wvalue, value, what)) {
+        return -1;
+    }
+    return _check_status(PI_PyWideStringList_Append(list, wvalue), "extend config list");
+}
+
+/*
+ * sys.prefix, sys.exec_prefix and their base_ variants are the directory of
+ * the application, sys.executable is the executable and sys.path = [mainpath].
+ * The modules needed to initialize Python come from the table of frozen
+ * modules.
+ */
+static int
+_set_paths(PyConfig *config, const PYCONFIG_LAYOUT *layout, ARCHIVE_STATUS *status)
+{
+    PyWideStringList *search_paths =
+        CONFIG_FIELD(config, layout, module_search_paths, PyWideStringList);
+
+    VS("LOADER: Manipulating environment (sys.path, sys.prefix)\n");
+    VS("LOADER: sys.prefix is %s\n", status->mainpath);
+
+    if (_set_string(config, CONFIG_FIELD(config, layout, program_name, wchar_t *),
+                    status->archivename, "progname") ||
+        _set_string(config, CONFIG_FIELD(config, layout, executable, wchar_t *),
+                    status->archivename, "executable") ||
+        _set_string(config, CONFIG_FIELD(config, layout, base_executable, wchar_t *),
+                    status->archivename, "executable") ||
+        _set_string(config, CONFIG_FIELD(config, layout, home, wchar_t *),
+                    status->mainpath, "pyhome") ||
+        _set_string(config, CONFIG_FIELD(config, layout, prefix, wchar_t *),
+                    status->mainpath, "prefix") ||
+        _set_string(config, CONFIG_FIELD(config, layout, base_prefix, wchar_t *),
+                    status->mainpath, "prefix") ||
+        _set_string(config, CONFIG_FIELD(config, layout, exec_prefix, wchar_t *),
+                    status->mainpath, "prefix") ||
+        _set_string(config, CONFIG_FIELD(config, layout, base_exec_prefix, wchar_t *),
+                    status->mainpath, "prefix")) {
+        return -1;
+    }
+
+    if (layout->stdlib_dir &&
+        _set_string(config, CONFIG_FIELD(config, layout, stdlib_dir, wchar_t *),
+                    status->mainpath, "stdlib_dir")) {
+        return -1;
+    }
+
+    VS("LOADER: sys.path is %s\n", status->mainpath);
+
+    if (_append(search_paths, status->mainpath, "pypath")) {
+        return -1;
+    }
+    CONFIG_INT(config, layout, module_search_paths_set) = 1;
+    return 0;
+}
+
+static int
+_set_argv(PyConfig *config, ARCHIVE_STATUS *status)
+{
+    wchar_t **wargv;
+    int rc;
+
+    VS("LOADER: Setting sys.argv\n");
+
+#ifdef _WIN32
+    /* Convert UTF-8 argv back to wargv */
+    wargv = pyi_win32_wargv_from_utf8(status->argc, status->argv);
+#else
+    /* Convert argv to wargv using Python's Py_DecodeLocale */
+    wargv = pyi_wargv_from_argv(status->argc, status->argv);
+#endif
+
+    if (!wargv) {
+        FATALERROR("Failed to convert argv to wchar_t\n");
+        return -1;
+    }
+    rc = _check_status(PI_PyConfig_SetArgv(config, status->argc, wargv), "set sys.argv");
+    pyi_free_wargv(wargv);
+    return rc;
+}
+
+/*
+ * The defaults match the flags set by pyi_pylib_set_runtime_opts(), and the
+ * runtime options ('o' entries) from the PKG archive override them.
+ */
+static int
+_set_runtime_opts(PyConfig *config, const PYCONFIG_LAYOUT *layout, ARCHIVE_STATUS *status)
+{
+    TOC *ptoc = status->tocbuff;
+    wchar_t wchar_tmp[PATH_MAX + 1];
+
+    /* Neither 'import site' nor the user's site directory. */
+    CONFIG_INT(config, layout, site_import) = 0;
+    CONFIG_INT(config, layout, user_site_directory) = 0;
+    /* Ignore PYTHON* environment variables, PYTHONHASHSEED included. */
+    CONFIG_INT(config, layout, isolated) = 1;
+    CONFIG_INT(config, layout, use_environment) = 0;
+    CONFIG_INT(config, layout, use_hash_seed) = 0;
+    *CONFIG_FIELD(config, layout, hash_seed, unsigned long) = 0;
+    /* Suppress writing bytecode files (*.py[co]) */
+    CONFIG_INT(config, layout, write_bytecode) = 0;
+    /* Like Py_FrozenFlag: no warnings about the path configuration. */
+    CONFIG_INT(config, layout, pathconfig_warnings) = 0;
+    /* Unlike the isolated default, raise KeyboardInterrupt on SIGINT. */
+    CONFIG_INT(config, layout, install_signal_handlers) = 1;
+    CONFIG_INT(config, layout, parse_argv) = 0;
+    CONFIG_INT(config, layout, verbose) = 0;
+    CONFIG_INT(config, layout, optimization_level) = 0;
+    CONFIG_INT(config, layout, buffered_stdio) = 1;
+    CONFIG_INT(config, layout, configure_c_stdio) = 0;
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd != ARCHIVE_ITEM_RUNTIME_OPTION) {
+            continue;
+        }
+        if (0 == strncmp(ptoc->name, "pyi-", 4)) {
+            VS("LOADER: Bootloader option: %s\n", ptoc->name);
+            continue;  /* Not handled here - use pyi_arch_get_option(status, ...) */
+        }
+        VS("LOADER: Runtime option: %s\n", ptoc->name);
+
+        switch (ptoc->name[0]) {
+        case 'v':
+            CONFIG_INT(config, layout, verbose) = 1;
+            break;
+        case 'u':
+            /* Unbuffered sys.std* streams and C stdio. */
+            CONFIG_INT(config, layout, buffered_stdio) = 0;
+            CONFIG_INT(config, layout, configure_c_stdio) = 1;
+            break;
+        case 'W':
+            if ((size_t)-1 == mbstowcs(wchar_tmp, &ptoc->name[2], PATH_MAX)) {
+                FATALERROR("Failed to convert Wflag %s using mbstowcs "
+                           "(invalid multibyte string)\n", &ptoc->name[2]);
+                return -1;
+            }
+            if (_check_status(PI_PyWideStringList_Append(
+                                  CONFIG_FIELD(config, layout, warnoptions,
+                                               PyWideStringList),
+                                  wchar_tmp), "add warning option")) {
+                return -1;
+            }
+            break;
+        case 'O':
+            CONFIG_INT(config, layout, optimization_level) = 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Return the UTF-8 mode requested by a runtime option 'X utf8' or
+ * 'X utf8=0|1', as with the -X option of python. It is off by default, as
+ * with Py_Initialize().
+ */
+static int
+_get_utf8_mode(ARCHIVE_STATUS *status)
+{
+    TOC *ptoc = status->tocbuff;
+    int utf8_mode = 0;
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd != ARCHIVE_ITEM_RUNTIME_OPTION) {
+            continue;
+        }
+        if (strcmp(ptoc->name, "X utf8") == 0 || strcmp(ptoc->name, "X utf8=1") == 0) {
+            utf8_mode = 1;
+        }
+        else if (strcmp(ptoc->name, "X utf8=0") == 0) {
+            utf8_mode = 0;
+        }
+    }
+    return utf8_mode;
+}
+
+int
+pyi_pyconfig_start_python(ARCHIVE_STATUS *status)
+{
+    const PYCONFIG_LAYOUT *layout = _get_layout();
+    PyPreConfig preconfig;
+    PyConfig *config;
+    PyStatus pystatus;
+    int rc = -1;
+
+    /*
+     * Pre-initialization sets the locale and the memory allocator, so it has
+     * to be done before any string is passed to PyConfig.
+     */
+    VS("LOADER: Pre-initializing python\n");
+    PI_PyPreConfig_InitPythonConfig(&preconfig);
+    preconfig.parse_argv = 0;
+    preconfig.isolated = 1;
+    preconfig.use_environment = 0;
+    preconfig.coerce_c_locale = 0;
+    preconfig.coerce_c_locale_warn = 0;
+    preconfig.utf8_mode = _get_utf8_mode(status);
+
+    if (_check_status(PI_Py_PreInitialize(&preconfig), "pre-initialize Python")) {
+        return -1;
+    }
+
+    config = (PyConfig *)calloc(1, layout->size + PYCONFIG_SLACK);
+
+    if (config == NULL) {
+        FATAL_PERROR("calloc", "Could not allocate PyConfig.\n");
+        return -1;
+    }
+    PI_PyConfig_InitIsolatedConfig(config);
+
+    VS("LOADER: Setting runtime options\n");
+
+    if (_set_paths(config, layout, status) ||
+        _set_argv(config, status) ||
+        _set_runtime_opts(config, layout, status)) {
+        goto cleanup;
+    }
+
+    /* See pyi_pylib_start_python() */
+#if defined(_WIN32) && defined(LAUNCH_DEBUG)
+    SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOGPFAULTERRORBOX);
+#endif
+
+    VS("LOADER: Initializing python\n");
+    pystatus = PI_Py_InitializeFromConfig(config);
+
+#if defined(_WIN32) && defined(LAUNCH_DEBUG)
+    SetErrorMode(0);
+#endif
+
+    if (_check_status(pystatus, "initialize Python")) {
+        goto cleanup;
+    }
+
+    /* Check for a python error */
+    if (PI_PyErr_Occurred()) {
+        FATALERROR("Error detected starting Python VM.");
+        goto cleanup;
+    }
+    rc = 0;
+
+cleanup:
+    PI_PyConfig_Clear(config);
+    free(config);
+    return rc;
+}
@@ -0,0 +1,36 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Interpreter initialization with PyPreConfig/PyConfig (Python 3.8+).
+ */
+
+#ifndef PYI_PYCONFIG_H
+#define PYI_PYCONFIG_H
+
+#include "pyi_archive.h"
+
+/*
+ * Return non-zero if the loaded Python library can be initialized with
+ * pyi_pyconfig_start_python(): the PyConfig layout of its version is known
+ * and all required functions were found.
+ */
+int pyi_pyconfig_is_supported(void);
+
+/*
+ * Initialize Python from a single PyConfig: sys.path, sys.prefix,
+ * sys.executable, sys.argv and the runtime options are all set before the
+ * interpreter starts, so Python does not compute them from the filesystem.
+ *
+ * Return 0 on success.
+ */
+int pyi_pyconfig_start_python(ARCHIVE_STATUS *status);
+
+#endif  /* PYI_PYCONFIG_H */
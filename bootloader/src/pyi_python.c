@@ -37,6 +37,8 @@ DECLVAR(Py_NoSiteFlag);
 DECLVAR(Py_NoUserSiteDirectory);
 DECLVAR(Py_OptimizeFlag);
 DECLVAR(Py_VerboseFlag);
+DECLVAR(PyImport_FrozenModules);
+DECLVAR(PyExc_ValueError);
 
 /* functions with prefix `Py_` */
 DECLPROC(Py_BuildValue);
@@ -82,6 +84,28 @@ DECLPROC(PyUnicode_Decode);
 DECLPROC(PyEval_EvalCode);
 DECLPROC(PyMarshal_ReadObjectFromString);
 
+DECLPROC(PyCFunction_NewEx);
+DECLPROC(PyTuple_GetItem);
+DECLPROC(PyBytes_AsStringAndSize);
+DECLPROC(PyBytes_FromStringAndSize);
+DECLPROC(PyBytes_AsString);
+DECLPROC(PyErr_SetString);
+
+DECLPROC(PyPreConfig_InitPythonConfig);
+DECLPROC(Py_PreInitialize);
+DECLPROC(PyConfig_InitIsolatedConfig);
+DECLPROC(PyConfig_Clear);
+DECLPROC(PyConfig_SetString);
+DECLPROC(PyConfig_SetArgv);
+DECLPROC(PyWideStringList_Append);
+DECLPROC(Py_InitializeFromConfig);
+DECLPROC(PyStatus_Exception);
+
+DECLPROC(PyOS_AfterFork);
+DECLPROC(PyOS_BeforeFork);
+DECLPROC(PyOS_AfterFork_Parent);
+DECLPROC(PyOS_AfterFork_Child);
+
 /*
  * Get all of the entry points from libpython
  * that we are interested in.
@@ -97,6 +121,7 @@ pyi_python_map_names(HMODULE dll, int pyvers)
     GETVAR(dll, Py_NoUserSiteDirectory);
     GETVAR(dll, Py_OptimizeFlag);
     GETVAR(dll, Py_VerboseFlag);
+    GETVAR(dll, PyImport_FrozenModules);
 
     /* functions with prefix `Py_` */
     GETPROC(dll, Py_BuildValue);
@@ -168,6 +193,48 @@ pyi_python_map_names(HMODULE dll, int pyvers)
         GETPROC(dll, PyUnicode_DecodeFSDefault);
     }
 
+    if (pyvers >= 30) {
+        /* for the built-in AES decryption */
+        GETVAR(dll, PyExc_ValueError);
+        GETPROC(dll, PyCFunction_NewEx);
+        GETPROC(dll, PyTuple_GetItem);
+        GETPROC(dll, PyBytes_AsStringAndSize);
+        GETPROC(dll, PyBytes_FromStringAndSize);
+        GETPROC(dll, PyBytes_AsString);
+        GETPROC(dll, PyErr_SetString);
+    }
+
+    /*
+     * Optional, the interpreter is initialized the legacy way (with
+     * Py_Initialize) if any of them is missing.
+     */
+    if (pyvers >= 38) {
+        /* new in Python 3.8 */
+        GETPROCOPT(dll, PyPreConfig_InitPythonConfig, PyPreConfig_InitPythonConfig);
+        GETPROCOPT(dll, Py_PreInitialize, Py_PreInitialize);
+        GETPROCOPT(dll, PyConfig_InitIsolatedConfig, PyConfig_InitIsolatedConfig);
+        GETPROCOPT(dll, PyConfig_Clear, PyConfig_Clear);
+        GETPROCOPT(dll, PyConfig_SetString, PyConfig_SetString);
+        GETPROCOPT(dll, PyConfig_SetArgv, PyConfig_SetArgv);
+        GETPROCOPT(dll, PyWideStringList_Append, PyWideStringList_Append);
+        GETPROCOPT(dll, Py_InitializeFromConfig, Py_InitializeFromConfig);
+        GETPROCOPT(dll, PyStatus_Exception, PyStatus_Exception);
+    }
+
+#ifndef _WIN32
+
+    /* Optional, only zygote mode needs them. */
+    if (pyvers >= 37) {
+        /* new in Python 3.7 */
+        GETPROCOPT(dll, PyOS_BeforeFork, PyOS_BeforeFork);
+        GETPROCOPT(dll, PyOS_AfterFork_Parent, PyOS_AfterFork_Parent);
+        GETPROCOPT(dll, PyOS_AfterFork_Child, PyOS_AfterFork_Child);
+    }
+    else {
+        GETPROCOPT(dll, PyOS_AfterFork, PyOS_AfterFork);
+    }
+#endif
+
     VS("LOADER: Loaded functions from Python library.\n");
 
     return 0;
@@ -22,6 +22,7 @@
 #ifdef _WIN32
     #include <windows.h>  /* HMODULE */
 #endif
+#include <stddef.h>  /* ptrdiff_t */
 #include <wchar.h>
 #include "pyi_python27_compat.h"
 
@@ -76,6 +77,57 @@ typedef struct _object PyObject;
 struct _PyThreadState;
 typedef struct _PyThreadState PyThreadState;
 
+/*
+ * Types of the PyConfig initialization API (new in Python 3.8). Their layout
+ * is the same in all Python versions supported by pyi_pyconfig.c. PyConfig
+ * itself changes between versions and is only used through pointers here.
+ */
+typedef struct {
+    int _type;  /* enum: 0 = ok, 1 = error, 2 = exit */
+    const char *func;
+    const char *err_msg;
+    int exitcode;
+} PyStatus;
+
+typedef struct {
+    ptrdiff_t length;  /* Py_ssize_t */
+    wchar_t **items;
+} PyWideStringList;
+
+typedef struct {
+    int _config_init;
+    int parse_argv;
+    int isolated;
+    int use_environment;
+    int configure_locale;
+    int coerce_c_locale;
+    int coerce_c_locale_warn;
+#ifdef _WIN32
+    int legacy_windows_fs_encoding;
+#endif
+    int utf8_mode;
+    int dev_mode;
+    int allocator;
+} PyPreConfig;
+
+struct _PyConfig;
+typedef struct _PyConfig PyConfig;
+
+/*
+ * Built-in functions defined by the bootloader. PyMethodDef has the same
+ * layout in all Python versions.
+ */
+typedef PyObject *(*PyCFunction)(PyObject *, PyObject *);
+
+typedef struct {
+    const char *ml_name;
+    PyCFunction ml_meth;
+    int ml_flags;
+    const char *ml_doc;
+} PyMethodDef;
+
+#define METH_VARARGS  0x0001
+
 /* The actual declarations of var & function entry points used. */
 
 /* Flags. */
@@ -87,6 +139,11 @@ EXTDECLVAR(int, Py_VerboseFlag);
 EXTDECLVAR(int, Py_IgnoreEnvironmentFlag);
 EXTDECLVAR(int, Py_DontWriteBytecodeFlag);
 EXTDECLVAR(int, Py_NoUserSiteDirectory);
+/* Table of frozen modules, an array of 'struct _frozen' */
+EXTDECLVAR(const void *, PyImport_FrozenModules);
+
+/* Exceptions. */
+EXTDECLVAR(PyObject *, PyExc_ValueError);
 
 /* This initializes the table of loaded modules (sys.modules), and creates the fundamental modules builtins, __main__ and sys. It also initializes the module search path (sys.path). It does not set sys.argv; */
 EXTDECLPROC(int, Py_Initialize, (void));
@@ -151,6 +208,31 @@ EXTDECLPROC(PyObject *, PyUnicode_Decode,
 EXTDECLPROC(PyObject *, PyEval_EvalCode, (PyObject *, PyObject *, PyObject *));
 EXTDECLPROC(PyObject *, PyMarshal_ReadObjectFromString, (const char *, size_t));  /* Py_ssize_t */
 
+/* Used by the built-in AES decryption, see pyi_aes.c. Only used on py3. */
+EXTDECLPROC(PyObject *, PyCFunction_NewEx, (PyMethodDef *, PyObject *, PyObject *));
+EXTDECLPROC(PyObject *, PyTuple_GetItem, (PyObject *, ptrdiff_t));  /* Py_ssize_t */
+EXTDECLPROC(int, PyBytes_AsStringAndSize, (PyObject *, char **, ptrdiff_t *));  /* Py_ssize_t */
+EXTDECLPROC(PyObject *, PyBytes_FromStringAndSize, (const char *, ptrdiff_t));  /* Py_ssize_t */
+EXTDECLPROC(char *, PyBytes_AsString, (PyObject *));
+EXTDECLPROC(void, PyErr_SetString, (PyObject *, const char *));
+
+/* PyConfig initialization API, new in Python 3.8 (see pyi_pyconfig.c) */
+EXTDECLPROC(void, PyPreConfig_InitPythonConfig, (PyPreConfig *));
+EXTDECLPROC(PyStatus, Py_PreInitialize, (const PyPreConfig *));
+EXTDECLPROC(void, PyConfig_InitIsolatedConfig, (PyConfig *));
+EXTDECLPROC(void, PyConfig_Clear, (PyConfig *));
+EXTDECLPROC(PyStatus, PyConfig_SetString, (PyConfig *, wchar_t **, const wchar_t *));
+EXTDECLPROC(PyStatus, PyConfig_SetArgv, (PyConfig *, ptrdiff_t, wchar_t * const *));  /* Py_ssize_t */
+EXTDECLPROC(PyStatus, PyWideStringList_Append, (PyWideStringList *, const wchar_t *));
+EXTDECLPROC(PyStatus, Py_InitializeFromConfig, (const PyConfig *));
+EXTDECLPROC(int, PyStatus_Exception, (PyStatus));
+
+/* Used to keep the interpreter consistent across fork() in zygote mode */
+EXTDECLPROC(void, PyOS_AfterFork, (void));         /* before Python 3.7 */
+EXTDECLPROC(void, PyOS_BeforeFork, (void));        /* new in Python 3.7 */
+EXTDECLPROC(void, PyOS_AfterFork_Parent, (void));  /* new in Python 3.7 */
+EXTDECLPROC(void, PyOS_AfterFork_Child, (void));   /* new in Python 3.7 */
+
 /*
  * Macros for reference counting through exported functions
  * (that is: without binding to the binary structure of a PyObject.
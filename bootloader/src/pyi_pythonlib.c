@@ -42,6 +42,8 @@
 #include "pyi_archive.h"
 #include "pyi_utils.h"
 #include "pyi_python.h"
+#include "pyi_pythonlib.h"
+#include "pyi_pyconfig.h"
 #include "pyi_win32_utils.h"
 
 /*
@@ -302,7 +304,7 @@ pyi_wargv_from_argv(int argc, char ** argv)
  * sys.argv[0] should be full absolute path to the executable (Derived from
  * status->archivename).
  */
-static int
+int
 pyi_pylib_set_sys_argv(ARCHIVE_STATUS *status)
 {
     char ** mbcs_argv;
@@ -384,6 +386,157 @@ pyi_locale_char2wchar(wchar_t * dst, char * src, size_t len)
 #endif /* ifdef _WIN32 */
 }
 
+/*
+ * Entry of PyImport_FrozenModules ('struct _frozen' in Python.h). Python 3.11
+ * added 'is_package' and 'get_code' (3.11 and 3.12 only), before that
+ * packages have a negative 'size'. PYI_FROZEN has all fields, only the ones
+ * of the running version are accessed.
+ */
+typedef struct _pyi_frozen {
+    const char *name;
+    const unsigned char *code;
+    int size;
+    int is_package;   /* new in Python 3.11 */
+    void *get_code;   /* Python 3.11 and 3.12 */
+} PYI_FROZEN;
+
+typedef struct {
+    const char *name;
+    const unsigned char *code;
+    int size;
+} PYI_FROZEN_V30;
+
+typedef struct {
+    const char *name;
+    const unsigned char *code;
+    int size;
+    int is_package;
+} PYI_FROZEN_V313;
+
+static size_t
+_frozen_entry_size(void)
+{
+    /* pyvers is major * 10 + minor: 3.11 is 41, 3.13 is 43 */
+    if (pyvers >= 43) {
+        return sizeof(PYI_FROZEN_V313);
+    }
+    else if (pyvers >= 41) {
+        return sizeof(PYI_FROZEN);
+    }
+    return sizeof(PYI_FROZEN_V30);
+}
+
+/*
+ * Add the modules of the 'f' entry (written by write_frozen_modules() in
+ * PyInstaller/depend/utils.py) to the modules frozen into the Python library.
+ * Python's FrozenImporter then imports them from memory while Python
+ * initializes, before sys.path is used.
+ *
+ * Must be called before Py_Initialize. Python keeps pointers into the
+ * table and the code, so neither is ever freed.
+ */
+static int
+pyi_pylib_install_frozen_modules(ARCHIVE_STATUS *status)
+{
+    TOC *ptoc;
+    unsigned char *data;
+    unsigned char *p;
+    unsigned char *end;
+    char *table;
+    const char *builtin = *PI_PyImport_FrozenModules;
+    size_t stride = _frozen_entry_size();
+    uint32_t count;
+    uint32_t i;
+    size_t nbuiltin = 0;
+    PYI_FROZEN *entry;
+
+    for (ptoc = status->tocbuff; ptoc < status->tocend;
+         ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd == ARCHIVE_ITEM_FROZEN_MODULES) {
+            break;
+        }
+    }
+
+    if (ptoc >= status->tocend) {
+        return 0;
+    }
+
+    data = pyi_arch_extract(status, ptoc);
+
+    if (data == NULL) {
+        return -1;
+    }
+    end = data + ntohl(ptoc->ulen);
+
+    if (end - data < 4) {
+        FATALERROR("Table of frozen modules is corrupted\n");
+        free(data);
+        return -1;
+    }
+    memcpy(&count, data, 4);
+    count = ntohl(count);
+
+    /* Keep the modules frozen into Python, _frozen_importlib among them. */
+    while (builtin && ((const PYI_FROZEN *) (builtin + nbuiltin * stride))->name) {
+        nbuiltin++;
+    }
+
+    /* The table ends with an entry of NULLs. */
+    table = calloc(nbuiltin + count + 1, stride);
+
+    if (table == NULL) {
+        FATAL_PERROR("calloc", "Could not allocate table of frozen modules.\n");
+        free(data);
+        return -1;
+    }
+
+    if (nbuiltin) {
+        memcpy(table, builtin, nbuiltin * stride);
+    }
+
+    for (i = 0, p = data + 4; i < count; i++) {
+        uint32_t size;
+        int is_package;
+        const char *name;
+
+        if (end - p < 5) {
+            break;
+        }
+        memcpy(&size, p, 4);
+        size = ntohl(size);
+        is_package = p[4];
+        name = (const char *) p + 5;
+        p += 5 + strnlen(name, end - p - 5) + 1;
+
+        if (p > end || (size_t) (end - p) < size) {
+            break;
+        }
+        entry = (PYI_FROZEN *) (table + (nbuiltin + i) * stride);
+        entry->name = name;
+        entry->code = p;
+        entry->size = (int) size;
+
+        if (pyvers >= 41) {
+            entry->is_package = is_package;
+        }
+        else if (is_package) {
+            entry->size = -entry->size;
+        }
+        p += size;
+    }
+
+    if (i < count) {
+        FATALERROR("Table of frozen modules is corrupted\n");
+        free(table);
+        free(data);
+        return -1;
+    }
+
+    VS("LOADER: Installed %u frozen modules\n", count);
+    *PI_PyImport_FrozenModules = table;
+    return 0;
+}
+
 /*
  * Start python - return 0 on success
  */
@@ -408,6 +561,15 @@ pyi_pylib_start_python(ARCHIVE_STATUS *status)
     static wchar_t pyhome_w[PATH_MAX + 1];
     static wchar_t progname_w[PATH_MAX + 1];
 
+    if (!is_py2 && pyi_pylib_install_frozen_modules(status)) {
+        return -1;
+    }
+
+    /* Python 3.8+ is configured with a single PyConfig instead. */
+    if (pyi_pyconfig_is_supported()) {
+        return pyi_pyconfig_start_python(status);
+    }
+
     if (is_py2) {
 #ifdef _WIN32
 
@@ -458,23 +620,13 @@ pyi_pylib_start_python(ARCHIVE_STATUS *status)
         PI_Py_SetPythonHome(pyhome_w);
     };
 
-    /* Set sys.path */
-    if (is_py2) {
-        /* sys.path = [mainpath] */
-        strncpy(pypath, status->mainpath, strlen(status->mainpath));
-    }
-    else {
-        /* sys.path = [base_library, mainpath] */
-        strncpy(pypath, status->mainpath, strlen(status->mainpath));
-        strncat(pypath, PYI_SEPSTR, strlen(PYI_SEPSTR));
-        strncat(pypath, "base_library.zip", strlen("base_library.zip"));
-        strncat(pypath, PYI_PATHSEPSTR, strlen(PYI_PATHSEPSTR));
-        strncat(pypath, status->mainpath, strlen(status->mainpath));
-    };
+    /* Set sys.path = [mainpath] */
+    strncpy(pypath, status->mainpath, strlen(status->mainpath));
 
     /*
-     * On Python 3, we must set sys.path to have base_library.zip before
-     * calling Py_Initialize as it needs `encodings` and other modules.
+     * On Python 3, we must set sys.path before calling Py_Initialize, or
+     * Python computes it. The `encodings` and other modules it needs come
+     * from the table of frozen modules.
      */
     if (!is_py2) {
         /* Decode using current locale */
@@ -565,10 +717,15 @@ pyi_pylib_start_python(ARCHIVE_STATUS *status)
 int
 pyi_pylib_import_modules(ARCHIVE_STATUS *status)
 {
-    PyObject *marshal;
-    PyObject *marshaldict;
-    PyObject *loadfunc;
     TOC *ptoc;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t maxlen = 0;
+    uint32_t hdrlen;
+    int found = 0;
+    unsigned char *raw;
+    unsigned char *modbuf;
+    unsigned char *data;
     PyObject *co;
     PyObject *mod;
     PyObject *meipass_obj;
@@ -611,53 +768,92 @@ pyi_pylib_import_modules(ARCHIVE_STATUS *status)
 
     VS("LOADER: importing modules from CArchive\n");
 
-    /* Get the Python function marshall.load
-     * Here we collect some reference to PyObject that we don't dereference
-     * Doesn't matter because the objects won't be going away anyway.
+    /* Find the part of the archive holding the module entries (type 'm'/'M')
+     * and the size of the largest module. This is normally just bootstrap
+     * stuff (archive and iu), stored next to each other.
+     */
+    ptoc = status->tocbuff;
+
+    while (ptoc < status->tocend) {
+        if (ptoc->typcd == ARCHIVE_ITEM_PYMODULE ||
+            ptoc->typcd == ARCHIVE_ITEM_PYPACKAGE) {
+            if (!found || ntohl(ptoc->pos) < start) {
+                start = ntohl(ptoc->pos);
+            }
+
+            if (!found || ntohl(ptoc->pos) + ntohl(ptoc->len) > end) {
+                end = ntohl(ptoc->pos) + ntohl(ptoc->len);
+            }
+
+            if (ptoc->cflag == '\1' && ntohl(ptoc->ulen) > maxlen) {
+                maxlen = ntohl(ptoc->ulen);
+            }
+            found = 1;
+        }
+        ptoc = pyi_arch_increment_toc_ptr(status, ptoc);
+    }
+
+    if (!found) {
+        return 0;
+    }
+
+    /* Read all of them at once, and decompress each one into the same
+     * buffer: the code objects do not refer to the data they are read from.
      */
-    marshal = PI_PyImport_ImportModule("marshal");
-    marshaldict = PI_PyModule_GetDict(marshal);
-    loadfunc = PI_PyDict_GetItemString(marshaldict, "loads");
+    raw = pyi_arch_read_raw(status, start, end - start);
+    modbuf = (unsigned char *) malloc(maxlen ? maxlen : 1);
+
+    if (raw == NULL || modbuf == NULL) {
+        FATALERROR("Failed to read modules from CArchive.\n");
+        free(raw);
+        free(modbuf);
+        return -1;
+    }
 
-    /* Iterate through toc looking for module entries (type 'm')
-     * this is normally just bootstrap stuff (archive and iu)
+    /* .pyc/.pyo files have 8 bytes header. From Python 3.3 the header is
+     * 12 bytes, and from Python 3.7 16 bytes. Skip it and load marshalled
+     * data from the right point.
      */
+    if (is_py2) {
+        hdrlen = 8;
+    }
+    else if (pyvers >= 37) {
+        hdrlen = 16;
+    }
+    else {
+        hdrlen = 12;
+    }
+
     ptoc = status->tocbuff;
 
     while (ptoc < status->tocend) {
         if (ptoc->typcd == ARCHIVE_ITEM_PYMODULE ||
             ptoc->typcd == ARCHIVE_ITEM_PYPACKAGE) {
-            unsigned char *modbuf = pyi_arch_extract(status, ptoc);
+            if (pyi_arch_check_digest(status, ptoc,
+                                      raw + ntohl(ptoc->pos) - start) != 0) {
+                free(modbuf);
+                free(raw);
+                return -1;
+            }
+            data = pyi_arch_extract_from(status, ptoc, raw + ntohl(ptoc->pos) - start,
+                                         modbuf);
 
             VS("LOADER: extracted %s\n", ptoc->name);
 
-            /* .pyc/.pyo files have 8 bytes header. Skip it and load marshalled
-             * data form the right point.
-             */
-            if (is_py2) {
-                co = PI_PyObject_CallFunction(loadfunc, "s#", modbuf + 8, ntohl(
-                                                  ptoc->ulen) - 8);
-            }
-            else if (pyvers >= 37) {
-                /* Python >= 3.7 the header: size was changed to 16 bytes. */
-                co = PI_PyObject_CallFunction(loadfunc, "y#", modbuf + 16,
-                                              ntohl(ptoc->ulen) - 16);
+            if (data != NULL && ntohl(ptoc->ulen) >= hdrlen) {
+                co = PI_PyMarshal_ReadObjectFromString((const char *) data + hdrlen,
+                                                       ntohl(ptoc->ulen) - hdrlen);
             }
             else {
-                /* It looks like from python 3.3 the header */
-                /* size was changed to 12 bytes. */
-                co =
-                    PI_PyObject_CallFunction(loadfunc, "y#", modbuf + 12, ntohl(
-                                                 ptoc->ulen) - 12);
-            };
+                co = NULL;
+            }
 
             if (co != NULL) {
-                VS("LOADER: callfunction returned...\n");
+                VS("LOADER: unmarshalled code object...\n");
                 mod = PI_PyImport_ExecCodeModule(ptoc->name, co);
             }
             else {
-                /* TODO callfunctions might return NULL - find yout why and foor what modules. */
-                VS("LOADER: callfunction returned NULL");
+                VS("LOADER: failed to unmarshal code object\n");
                 mod = NULL;
             }
 
@@ -670,12 +866,13 @@ pyi_pylib_import_modules(ARCHIVE_STATUS *status)
                 PI_PyErr_Print();
                 PI_PyErr_Clear();
             }
-
-            free(modbuf);
         }
         ptoc = pyi_arch_increment_toc_ptr(status, ptoc);
     }
 
+    free(modbuf);
+    free(raw);
+
     return 0;
 }
 
@@ -785,6 +982,15 @@ pyi_pylib_install_zlibs(ARCHIVE_STATUS *status)
     while (ptoc < status->tocend) {
         if (ptoc->typcd == ARCHIVE_ITEM_PYZ) {
             VS("LOADER: PYZ archive: %s\n", ptoc->name);
+
+            /*
+             * The bootloader never extracts a PYZ, Python reads it directly:
+             * check it once against its digest. Uncompressed PYZs and stored
+             * members have no zlib checksum of their own.
+             */
+            if (pyi_arch_verify_entry(status, ptoc) != 0) {
+                return -1;
+            }
             pyi_pylib_install_zlib(status, ptoc);
         }
 
@@ -21,6 +21,11 @@ int pyi_pylib_start_python(ARCHIVE_STATUS *status);
 int pyi_pylib_import_modules(ARCHIVE_STATUS *status);
 int pyi_pylib_install_zlibs(ARCHIVE_STATUS *status);
 int pyi_pylib_run_scripts(ARCHIVE_STATUS *status);
+int pyi_pylib_set_sys_argv(ARCHIVE_STATUS *status);
+
+wchar_t **pyi_wargv_from_argv(int argc, char ** argv);
+void pyi_free_wargv(wchar_t ** wargv);
+wchar_t *pyi_locale_char2wchar(wchar_t * dst, char * src, size_t len);
 
 void pyi_pylib_finalize(ARCHIVE_STATUS *status);
 
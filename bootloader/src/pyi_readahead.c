@@ -0,0 +1,264 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Background readahead of binaries and archive ranges (POSIX only).
+ *
+ * The first import of a big extension module or shared library faults its
+ * pages in from disk on the main thread. With the pyi-readahead option the
+ * bootloader starts a detached helper process as soon as the paths are
+ * known. The helper asks the kernel to read the files into the page cache
+ * (posix_fadvise(POSIX_FADV_WILLNEED), or F_RDADVISE on Mac OS X) while the
+ * application process loads and initializes Python. The page cache is
+ * shared, so the application finds the pages there.
+ *
+ * The option value is a comma-separated list of names. A name of a PYZ
+ * archive selects its range in the executable, any other name a file or a
+ * directory (recursively) below the application directory. Without a list,
+ * all PYZ archives are read ahead, and in onedir mode all files of at least
+ * PYI_READAHEAD_MIN_SIZE bytes below the application directory. In onefile
+ * mode the extracted files were just written and are already cached.
+ */
+
+#ifndef _WIN32
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>      /* PATH_MAX */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __FreeBSD__
+    #include <arpa/inet.h>  /* ntohl */
+#else
+    #include <netinet/in.h>  /* ntohl */
+#endif
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_utils.h"
+#include "pyi_readahead.h"
+
+/* Directory levels searched below the application directory. */
+#define READAHEAD_MAX_DEPTH  16
+
+/*
+ * Ask the kernel to read 'len' bytes of 'fd' from 'offset' into the page
+ * cache. Does not wait for the data.
+ */
+static void
+_advise(int fd, off_t offset, off_t len)
+{
+#if defined(__APPLE__)
+    struct radvisory ra;
+
+    /* ra_count is an int: advise in chunks of at most 1 GiB. */
+    while (len > 0) {
+        ra.ra_offset = offset;
+        ra.ra_count = (int) (len < (1 << 30) ? len : (1 << 30));
+
+        if (fcntl(fd, F_RDADVISE, &ra) == -1) {
+            return;
+        }
+        offset += ra.ra_count;
+        len -= ra.ra_count;
+    }
+#elif defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+#else
+    /* No advice available: read the data ourselves. */
+    char buf[65536];
+    ssize_t n;
+
+    if (lseek(fd, offset, SEEK_SET) == (off_t) -1) {
+        return;
+    }
+
+    while (len > 0) {
+        n = read(fd, buf, len < (off_t) sizeof(buf) ? (size_t) len : sizeof(buf));
+
+        if (n <= 0) {
+            return;
+        }
+        len -= n;
+    }
+#endif
+}
+
+/* Read the file 'path' ahead if it is at least 'min_size' bytes long. */
+static void
+_readahead_file(const char *path, off_t min_size)
+{
+    struct stat sbuf;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &sbuf) == 0 && S_ISREG(sbuf.st_mode) &&
+        sbuf.st_size >= min_size && sbuf.st_size > 0) {
+        _advise(fd, 0, sbuf.st_size);
+    }
+    close(fd);
+}
+
+/*
+ * Read the file 'path' ahead or, if it is a directory, all files below it
+ * of at least 'min_size' bytes.
+ */
+static void
+_readahead_path(const char *path, off_t min_size, int depth)
+{
+    char child[PATH_MAX];
+    struct stat sbuf;
+    struct dirent *entry;
+    DIR *dir;
+
+    if (lstat(path, &sbuf) != 0) {
+        return;
+    }
+
+    if (!S_ISDIR(sbuf.st_mode)) {
+        /* Symbolic links are followed to files only. */
+        _readahead_file(path, min_size);
+        return;
+    }
+
+    if (depth > READAHEAD_MAX_DEPTH || (dir = opendir(path)) == NULL) {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        if (snprintf(child, PATH_MAX, "%s/%s", path, entry->d_name) < PATH_MAX) {
+            _readahead_path(child, min_size, depth + 1);
+        }
+    }
+    closedir(dir);
+}
+
+/* Return the PYZ entry called 'name', or NULL. */
+static TOC *
+_find_pyz(const ARCHIVE_STATUS *status, const char *name, size_t len)
+{
+    TOC *ptoc = status->tocbuff;
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if ((ptoc->typcd == ARCHIVE_ITEM_PYZ || ptoc->typcd == ARCHIVE_ITEM_ZIPFILE) &&
+            strncmp(ptoc->name, name, len) == 0 && ptoc->name[len] == '\0') {
+            return ptoc;
+        }
+    }
+    return NULL;
+}
+
+/* Read the data of the archive entry 'ptoc' ahead. */
+static void
+_readahead_entry(const ARCHIVE_STATUS *status, int fd, const TOC *ptoc)
+{
+    if (fd >= 0) {
+        _advise(fd, (off_t) status->pkgstart + ntohl(ptoc->pos), ntohl(ptoc->len));
+    }
+}
+
+/* Read ahead the names listed in 'list', see above. */
+static void
+_readahead_list(const ARCHIVE_STATUS *status, int fd, const char *list)
+{
+    char path[PATH_MAX];
+    const char *name = list;
+    const char *end;
+    TOC *ptoc;
+    size_t len;
+
+    while (*name) {
+        end = strchr(name, ',');
+        len = end ? (size_t) (end - name) : strlen(name);
+
+        if (len > 0) {
+            if ((ptoc = _find_pyz(status, name, len)) != NULL) {
+                _readahead_entry(status, fd, ptoc);
+            }
+            else if (snprintf(path, PATH_MAX, "%s/%.*s", status->mainpath,
+                              (int) len, name) < PATH_MAX) {
+                _readahead_path(path, 0, 0);
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        name = end + 1;
+    }
+}
+
+/* Read ahead all PYZ archives and, in onedir mode, the big files. */
+static void
+_readahead_default(const ARCHIVE_STATUS *status, int fd)
+{
+    TOC *ptoc = status->tocbuff;
+
+    for (; ptoc < status->tocend; ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd == ARCHIVE_ITEM_PYZ || ptoc->typcd == ARCHIVE_ITEM_ZIPFILE) {
+            _readahead_entry(status, fd, ptoc);
+        }
+    }
+
+    if (!status->has_temp_directory) {
+        _readahead_path(status->mainpath, PYI_READAHEAD_MIN_SIZE, 0);
+    }
+}
+
+void
+pyi_readahead_start(const ARCHIVE_STATUS *status)
+{
+    char *list = pyi_arch_get_option(status, "pyi-readahead");
+    int fd, rc;
+
+    if (list == NULL) {
+        return;
+    }
+    rc = pyi_utils_fork_detached();
+
+    if (rc < 0) {
+        VS("LOADER: Could not start readahead process\n");
+        return;
+    }
+
+    if (rc > 0) {
+        VS("LOADER: Reading ahead in the background\n");
+        return;
+    }
+
+    /* In the helper process. Inherited files were closed. */
+    fd = open(status->archivename, O_RDONLY);
+
+    if (*list) {
+        _readahead_list(status, fd, list);
+    }
+    else {
+        _readahead_default(status, fd);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    _exit(0);
+}
+
+#endif /* ifndef _WIN32 */
@@ -0,0 +1,35 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Background readahead of binaries and archive ranges (POSIX only).
+ */
+
+#ifndef PYI_READAHEAD_H
+#define PYI_READAHEAD_H
+
+#include "pyi_archive.h"
+
+#ifndef _WIN32
+
+/* Smallest file read ahead when no list is given in the pyi-readahead option. */
+#define PYI_READAHEAD_MIN_SIZE  (1024 * 1024)
+
+/*
+ * If the application was built with the pyi-readahead option, ask the kernel
+ * to read the listed files below status->mainpath and the PYZ archives into
+ * the page cache. This is done by a detached helper process, so that the
+ * disk reads overlap with the initialization of Python.
+ */
+void pyi_readahead_start(const ARCHIVE_STATUS *status);
+
+#endif /* ifndef _WIN32 */
+
+#endif  /* PYI_READAHEAD_H */
@@ -0,0 +1,445 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Batched extraction of archive entries with io_uring (Linux only).
+ *
+ * Entries are decompressed in the calling thread and their target files are
+ * opened directly, the write and the close of every file are queued on the
+ * ring as a linked pair and submitted in batches. Extracting many small files
+ * then costs the open and fchmod of each file, the writes and closes share
+ * a few system calls. A short write breaks the link, the rest is queued
+ * again with its own close. The ring is set up with raw
+ * system calls, liburing is not required.
+ */
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <errno.h>
+#include <limits.h>      /* PATH_MAX */
+#include <linux/io_uring.h>
+#include <netinet/in.h>  /* ntohl */
+#include <stdint.h>      /* uintptr_t */
+#include <stdio.h>
+#include <stdlib.h>      /* calloc */
+#include <string.h>      /* memset */
+#include <sys/mman.h>    /* mmap */
+#include <sys/syscall.h> /* __NR_io_uring_* */
+#include <unistd.h>      /* syscall, close */
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_utils.h"
+#include "pyi_uring.h"
+
+/* Number of submission queue entries. Every file takes two. */
+#define URING_ENTRIES 256
+
+/* Wait for the queued files when this much data is waiting to be written. */
+#define URING_MAX_PENDING_BYTES (64 * 1024 * 1024)
+
+/* Tag of the user_data of close requests; jobs are at least 2-aligned. */
+#define URING_CLOSE_TAG 1
+
+/* A file whose write and close are queued. */
+typedef struct _uring_job {
+    unsigned char *data;
+    unsigned int len;
+    unsigned int written;  /* Bytes confirmed by write completions. */
+    int fd;
+    int pending;           /* Completions still expected. */
+    int failed;
+    int close_cancelled;
+    const char *name;
+} URING_JOB;
+
+struct _pyi_uring {
+    int fd;
+    unsigned int entries;
+    /* Submission queue. */
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    /* Completion queue, may share the mapping of the submission queue. */
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    /* Bookkeeping. */
+    unsigned int queued;    /* Requests not yet submitted. */
+    unsigned int inflight;  /* Submitted requests without completion. */
+    size_t pending_bytes;
+    int error;
+};
+
+static int
+_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                         NULL, 0);
+}
+
+static int
+_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* Check that the kernel implements the operations used for extraction. */
+static int
+_uring_supported(int fd)
+{
+    struct io_uring_probe *probe;
+    size_t size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+    int rc = 0;
+
+    probe = (struct io_uring_probe *) calloc(1, size);
+
+    if (probe == NULL) {
+        return 0;
+    }
+
+    if (_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+        probe->last_op >= IORING_OP_CLOSE && probe->last_op >= IORING_OP_WRITE &&
+        (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) &&
+        (probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED)) {
+        rc = 1;
+    }
+    free(probe);
+    return rc;
+}
+
+static void
+_uring_free(PYI_URING *ring)
+{
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+
+    if (ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED &&
+        ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+
+    if (ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring);
+}
+
+PYI_URING *
+pyi_uring_new(void)
+{
+    struct io_uring_params p;
+    PYI_URING *ring;
+    char *sq;
+    char *cq;
+
+    ring = (PYI_URING *) calloc(1, sizeof(PYI_URING));
+
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = _uring_setup(URING_ENTRIES, &p);
+
+    /* ENOSYS on old kernels, EPERM if blocked by a seccomp filter. */
+    if (ring->fd < 0) {
+        VS("LOADER: io_uring not available: %s\n", strerror(errno));
+        free(ring);
+        return NULL;
+    }
+
+    if (!_uring_supported(ring->fd)) {
+        VS("LOADER: io_uring does not support the required operations\n");
+        _uring_free(ring);
+        return NULL;
+    }
+
+    ring->entries = p.sq_entries;
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) {
+            ring->sq_size = ring->cq_size;
+        }
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+
+    if (ring->sq_ptr == MAP_FAILED) {
+        _uring_free(ring);
+        return NULL;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    }
+    else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+
+        if (ring->cq_ptr == MAP_FAILED) {
+            _uring_free(ring);
+            return NULL;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqes_size,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE,
+                                              ring->fd, IORING_OFF_SQES);
+
+    if (ring->sqes == MAP_FAILED) {
+        _uring_free(ring);
+        return NULL;
+    }
+
+    sq = (char *) ring->sq_ptr;
+    ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+
+    cq = (char *) ring->cq_ptr;
+    ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    VS("LOADER: Extracting with io_uring\n");
+    return ring;
+}
+
+/* Return the next free submission queue entry, cleared. */
+static struct io_uring_sqe *
+_uring_get_sqe(PYI_URING *ring)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    /* Published by _uring_commit(). */
+    return sqe;
+}
+
+static void
+_uring_commit(PYI_URING *ring, unsigned count)
+{
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + count, __ATOMIC_RELEASE);
+    ring->queued += count;
+}
+
+/*
+ * Queue the write of the rest of the data of a job, linked to the close of
+ * its file. The close is cancelled by the kernel if the write fails or is
+ * short.
+ */
+static void
+_uring_queue_write(PYI_URING *ring, URING_JOB *job)
+{
+    struct io_uring_sqe *sqe;
+
+    job->pending = 2;
+    job->close_cancelled = 0;
+
+    sqe = _uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->fd = job->fd;
+    sqe->addr = (__u64) (uintptr_t) (job->data + job->written);
+    sqe->len = job->len - job->written;
+    sqe->off = job->written;
+    sqe->user_data = (__u64) (uintptr_t) job;
+    _uring_commit(ring, 1);
+
+    sqe = _uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = job->fd;
+    sqe->user_data = (__u64) (uintptr_t) job | URING_CLOSE_TAG;
+    _uring_commit(ring, 1);
+}
+
+/* Handle one completion. */
+static void
+_uring_complete(PYI_URING *ring, struct io_uring_cqe *cqe)
+{
+    URING_JOB *job = (URING_JOB *) (uintptr_t) (cqe->user_data & ~(__u64) URING_CLOSE_TAG);
+    int is_close = (cqe->user_data & URING_CLOSE_TAG) != 0;
+
+    if (!is_close) {
+        /*
+         * A short write is not an error, Linux writes at most about 2 GiB at
+         * once. The rest is written after the cancelled close has completed.
+         */
+        if (cqe->res <= 0) {
+            errno = cqe->res < 0 ? -cqe->res : EIO;
+            FATAL_PERROR("write", "Failed to write all bytes for %s\n", job->name);
+            job->failed = 1;
+        }
+        else {
+            job->written += (unsigned int) cqe->res;
+        }
+    }
+    else if (cqe->res == -ECANCELED) {
+        /* The write failed or was short and broke the link. */
+        job->close_cancelled = 1;
+    }
+    else if (cqe->res < 0) {
+        errno = -cqe->res;
+        FATAL_PERROR("close", "%s could not be extracted!\n", job->name);
+        job->failed = 1;
+    }
+
+    if (--job->pending > 0) {
+        return;
+    }
+
+    if (!job->failed && job->written < job->len) {
+        if (job->close_cancelled) {
+            _uring_queue_write(ring, job);
+            return;
+        }
+        /* Closed although the write was short, should not happen. */
+        errno = EIO;
+        FATAL_PERROR("write", "Failed to write all bytes for %s\n", job->name);
+        job->failed = 1;
+    }
+
+    if (job->close_cancelled) {
+        close(job->fd);
+    }
+
+    if (job->failed) {
+        ring->error = 1;
+    }
+    ring->pending_bytes -= job->len;
+    free(job->data);
+    free(job);
+}
+
+/* Submit the queued requests and wait until all of them have completed. */
+static void
+_uring_drain(PYI_URING *ring)
+{
+    unsigned head;
+    int rc;
+
+    while (ring->queued > 0 || ring->inflight > 0) {
+        rc = _uring_enter(ring->fd, ring->queued, 1, IORING_ENTER_GETEVENTS);
+
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            FATAL_PERROR("io_uring_enter", "Failed to extract files\n");
+            ring->error = 1;
+            return;
+        }
+        ring->queued -= (unsigned) rc;
+        ring->inflight += (unsigned) rc;
+
+        head = *ring->cq_head;
+
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            /* May queue the rest of a short write. */
+            ring->inflight--;
+            _uring_complete(ring, &ring->cqes[head & *ring->cq_mask]);
+            head++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+int
+pyi_uring_extract2fs(PYI_URING *ring, ARCHIVE_STATUS *status, TOC *ptoc)
+{
+    URING_JOB *job;
+
+    /* Create tmp dir _MEIPASSxxx. */
+    if (pyi_create_temp_path(status) == -1) {
+        return -1;
+    }
+
+    if (ring->queued + ring->inflight + 2 > ring->entries ||
+        ring->pending_bytes > URING_MAX_PENDING_BYTES) {
+        _uring_drain(ring);
+    }
+
+    if (ring->error) {
+        return -1;
+    }
+
+    job = (URING_JOB *) calloc(1, sizeof(URING_JOB));
+
+    if (job == NULL) {
+        OTHERERROR("Could not allocate memory\n");
+        return -1;
+    }
+    job->name = ptoc->name;
+    job->len = ntohl(ptoc->ulen);
+    job->data = pyi_arch_extract(status, ptoc);
+
+    if (job->data == NULL) {
+        free(job);
+        return -1;
+    }
+
+    job->fd = pyi_open_target_fd(status, ptoc->name);
+
+    if (job->fd < 0) {
+        FATAL_PERROR("open", "%s could not be extracted!\n", ptoc->name);
+        free(job->data);
+        free(job);
+        return -1;
+    }
+    ring->pending_bytes += job->len;
+    _uring_queue_write(ring, job);
+
+    return 0;
+}
+
+int
+pyi_uring_finish(PYI_URING *ring)
+{
+    int rc;
+
+    _uring_drain(ring);
+    rc = ring->error ? -1 : 0;
+    _uring_free(ring);
+    return rc;
+}
+
+#endif /* if defined(__linux__) && defined(HAVE_IO_URING) */
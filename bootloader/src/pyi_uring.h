@@ -0,0 +1,48 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Batched extraction of archive entries with io_uring (Linux only).
+ */
+
+#ifndef PYI_URING_H
+#define PYI_URING_H
+
+#include "pyi_archive.h"
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+    #define PYI_HAVE_URING
+
+typedef struct _pyi_uring PYI_URING;
+
+/*
+ * Set up a ring for extraction. Returns NULL if the running kernel does not
+ * support the required io_uring operations; use pyi_arch_extract2fs() then.
+ */
+PYI_URING *pyi_uring_new(void);
+
+/*
+ * Extract an entry like pyi_arch_extract2fs(). The file may still be written
+ * when the function returns; call pyi_uring_finish() before using it.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+int pyi_uring_extract2fs(PYI_URING *ring, ARCHIVE_STATUS *status, TOC *ptoc);
+
+/*
+ * Wait for all queued files to be written and closed, then free the ring.
+ *
+ * @return 0 if all files were extracted, non-zero otherwise.
+ */
+int pyi_uring_finish(PYI_URING *ring);
+
+#endif /* if defined(__linux__) && defined(HAVE_IO_URING) */
+
+#endif  /* PYI_URING_H */
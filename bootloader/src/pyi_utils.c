@@ -24,6 +24,7 @@
     #include <signal.h>  /* signal */
 #else
     #include <dirent.h>
+    #include <fcntl.h>  /* open, openat */
 /*
  * On AIX  RTLD_MEMBER  flag is only visible when _ALL_SOURCE flag is defined.
  *
@@ -363,6 +364,112 @@ pyi_get_temp_path(char *buff, char *runtime_tmpdir)
 
 #endif /* ifdef _WIN32 */
 
+#if !defined(_WIN32) && defined(HAVE_OPENAT)
+
+#ifndef O_CLOEXEC
+    #define O_CLOEXEC 0
+#endif
+
+/* A directory below temppath: the first 'len' characters of a TOC name. */
+typedef struct _target_dir {
+    const char *name;
+    size_t len;
+} TARGET_DIR;
+
+static int
+_cmp_target_dir(const void *a, const void *b)
+{
+    const TARGET_DIR *da = (const TARGET_DIR *) a;
+    const TARGET_DIR *db = (const TARGET_DIR *) b;
+    int rc = memcmp(da->name, db->name, da->len < db->len ? da->len : db->len);
+
+    if (rc != 0) {
+        return rc;
+    }
+    return da->len < db->len ? -1 : (da->len > db->len ? 1 : 0);
+}
+
+/*
+ * Create all directories that the files extracted to temppath end up in.
+ *
+ * The directories are collected from the TOC once, sorted (a directory
+ * always sorts before its subdirectories) and created in a single pass
+ * relative to a descriptor of temppath. pyi_open_target_fd() then no
+ * longer needs to stat and create the parents of each file.
+ *
+ * Failure is not fatal: files are then opened by their full path.
+ */
+static void
+_create_target_dirs(ARCHIVE_STATUS *status)
+{
+    TOC *ptoc;
+    TARGET_DIR *dirs;
+    size_t count = 0, created = 0, i;
+    const char *p;
+    char dir[PATH_MAX];
+
+    status->lastdirfd = -1;
+    status->tempfd = open(status->temppath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (status->tempfd < 0) {
+        return;
+    }
+
+    /* Upper bound for the number of directories: the separators in names. */
+    for (ptoc = status->tocbuff; ptoc < status->tocend;
+         ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        for (p = strchr(ptoc->name, PYI_SEP); p; p = strchr(p + 1, PYI_SEP)) {
+            count++;
+        }
+    }
+    dirs = (TARGET_DIR *) malloc((count ? count : 1) * sizeof(TARGET_DIR));
+
+    if (dirs == NULL) {
+        close(status->tempfd);
+        return;
+    }
+    count = 0;
+
+    for (ptoc = status->tocbuff; ptoc < status->tocend;
+         ptoc = pyi_arch_increment_toc_ptr(status, ptoc)) {
+        if (ptoc->typcd != ARCHIVE_ITEM_BINARY &&
+            ptoc->typcd != ARCHIVE_ITEM_DATA &&
+            ptoc->typcd != ARCHIVE_ITEM_ZIPFILE) {
+            continue;
+        }
+
+        for (p = strchr(ptoc->name, PYI_SEP); p; p = strchr(p + 1, PYI_SEP)) {
+            dirs[count].name = ptoc->name;
+            dirs[count].len = p - ptoc->name;
+            count++;
+        }
+    }
+    qsort(dirs, count, sizeof(TARGET_DIR), _cmp_target_dir);
+
+    for (i = 0; i < count; i++) {
+        if (dirs[i].len == 0 || dirs[i].len >= PATH_MAX ||
+            (i > 0 && _cmp_target_dir(&dirs[i - 1], &dirs[i]) == 0)) {
+            continue;
+        }
+        memcpy(dir, dirs[i].name, dirs[i].len);
+        dir[dirs[i].len] = '\0';
+
+        if (mkdirat(status->tempfd, dir, 0700) < 0 && errno != EEXIST) {
+            VS("LOADER: Cannot create directory %s: %s\n", dir, strerror(errno));
+            free(dirs);
+            close(status->tempfd);
+            return;
+        }
+        created++;
+    }
+    VS("LOADER: Created %d directories below %s\n", (int) created,
+       status->temppath);
+    free(dirs);
+    status->has_target_dirs = true;
+}
+
+#endif /* if !defined(_WIN32) && defined(HAVE_OPENAT) */
+
 /*
  * Creates a temporany directory if it doesn't exists
  * and properly sets the ARCHIVE_STATUS members.
@@ -384,6 +491,9 @@ pyi_create_temp_path(ARCHIVE_STATUS *status)
         }
         /* Set flag that temp directory is created and available. */
         status->has_temp_directory = true;
+#if !defined(_WIN32) && defined(HAVE_OPENAT)
+        _create_target_dirs(status);
+#endif
     }
     return 0;
 }
@@ -445,6 +555,60 @@ pyi_remove_temp_path(const char *dir)
     }
     _wrmdir(wdir);
 }
+#elif defined(HAVE_OPENAT)
+
+/*
+ * Remove the contents of the directory open as 'dfd' and close it.
+ *
+ * Entries are removed relative to the directory descriptor, so no paths
+ * are built and nothing is stat()ed: unlinkat() is tried first, and only
+ * entries that turn out to be directories are descended into.
+ */
+static void
+_remove_dir_contents(int dfd)
+{
+    DIR *ds = fdopendir(dfd);
+    struct dirent *finfo;
+    int fd;
+
+    if (ds == NULL) {
+        close(dfd);
+        return;
+    }
+
+    while ((finfo = readdir(ds)) != NULL) {
+        if (strcmp(finfo->d_name, ".") == 0 || strcmp(finfo->d_name, "..") == 0) {
+            continue;
+        }
+
+        if (unlinkat(dirfd(ds), finfo->d_name, 0) == 0) {
+            continue;
+        }
+
+        /* Linux reports EISDIR for directories, POSIX allows EPERM. */
+        if (errno == EISDIR || errno == EPERM) {
+            fd = openat(dirfd(ds), finfo->d_name,
+                        O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+            if (fd >= 0) {
+                _remove_dir_contents(fd);
+                unlinkat(dirfd(ds), finfo->d_name, AT_REMOVEDIR);
+            }
+        }
+    }
+    closedir(ds);
+}
+
+void
+pyi_remove_temp_path(const char *dir)
+{
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd >= 0) {
+        _remove_dir_contents(fd);
+    }
+    rmdir(dir);
+}
 #else /* ifdef _WIN32 */
 static void
 remove_one(char *pnm, int pos, const char *fnm)
@@ -496,6 +660,94 @@ pyi_remove_temp_path(const char *dir)
 }
 #endif /* ifdef _WIN32 */
 
+#ifndef _WIN32
+
+/*
+ * Fork a detached grandchild process. The grandchild runs in a new session,
+ * is reparented to init and does not keep the standard streams (or any
+ * other inherited file) open, so pipes to the caller see end-of-file when
+ * the caller exits.
+ *
+ * Returns 0 in the grandchild, 1 in the caller if the grandchild was
+ * started and -1 on error.
+ */
+int
+pyi_utils_fork_detached(void)
+{
+    pid_t pid;
+    int status, fd, maxfd;
+
+    pid = fork();
+
+    if (pid < 0) {
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* Intermediate child: start the grandchild in a new session and exit. */
+        setsid();
+        pid = fork();
+
+        if (pid != 0) {
+            _exit(pid < 0 ? 1 : 0);
+        }
+        fd = open("/dev/null", O_RDWR);
+
+        if (fd >= 0) {
+            dup2(fd, 0);
+            dup2(fd, 1);
+            dup2(fd, 2);
+        }
+        maxfd = (int) sysconf(_SC_OPEN_MAX);
+
+        if (maxfd < 0 || maxfd > 4096) {
+            maxfd = 4096;
+        }
+
+        for (fd = 3; fd < maxfd; fd++) {
+            close(fd);
+        }
+        return 0;
+    }
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return 1;
+}
+
+/*
+ * Remove the temporary directory in a detached grandchild process, so the
+ * caller can exit as soon as the application has finished.
+ *
+ * Returns 0 if the removal was handed off, -1 if the caller has to remove
+ * the directory itself.
+ */
+int
+pyi_remove_temp_path_detached(const char *dir)
+{
+    int rc = pyi_utils_fork_detached();
+
+    if (rc == 0) {
+        pyi_remove_temp_path(dir);
+        _exit(0);
+    }
+
+    if (rc < 0) {
+        return -1;
+    }
+    VS("LOADER: Removing %s in the background\n", dir);
+    return 0;
+}
+
+#endif /* ifndef _WIN32 */
+
 /* TODO is this function still used? Could it be removed? */
 /*
  * If binaries were extracted, this should be called
@@ -510,12 +762,11 @@ cleanUp(ARCHIVE_STATUS *status)
 }
 
 /*
- * helper for extract2fs
- * which may try multiple places
+ * Build the path of file 'name_' below 'path' in 'fnm' (PATH_MAX) and
+ * create its parent directories.
  */
-/* TODO find better name for function. */
-FILE *
-pyi_open_target(const char *path, const char* name_)
+static int
+_prepare_target(char *fnm, const char *path, const char* name_)
 {
 
 #ifdef _WIN32
@@ -524,7 +775,6 @@ pyi_open_target(const char *path, const char* name_)
 #else
     struct stat sbuf;
 #endif
-    char fnm[PATH_MAX];
     char name[PATH_MAX];
     char *dir;
     size_t len;
@@ -534,7 +784,7 @@ pyi_open_target(const char *path, const char* name_)
 
     /* Check if the path names could be copied */
     if (fnm[PATH_MAX-1] != '\0' || name[PATH_MAX-1] != '\0') {
-        return NULL;
+        return -1;
     }
 
     len = strlen(fnm);
@@ -544,7 +794,7 @@ pyi_open_target(const char *path, const char* name_)
         len += strlen(dir) + strlen(PYI_SEPSTR);
         /* Check if fnm does not exceed the buffer size */
         if (len >= PATH_MAX-1) {
-            return NULL;
+            return -1;
         }
         strcat(fnm, PYI_SEPSTR);
         strcat(fnm, dir);
@@ -580,6 +830,22 @@ pyi_open_target(const char *path, const char* name_)
         OTHERERROR("WARNING: file already exists but should not: %s\n", fnm);
     }
 #endif
+    return 0;
+}
+
+/*
+ * helper for extract2fs
+ * which may try multiple places
+ */
+/* TODO find better name for function. */
+FILE *
+pyi_open_target(const char *path, const char* name_)
+{
+    char fnm[PATH_MAX];
+
+    if (_prepare_target(fnm, path, name_) < 0) {
+        return NULL;
+    }
     /*
      * pyi_path_fopen() wraps different fopen names. On Windows it uses
      * wide-character version of fopen.
@@ -587,6 +853,107 @@ pyi_open_target(const char *path, const char* name_)
     return pyi_path_fopen(fnm, "wb");
 }
 
+#ifndef _WIN32
+
+/*
+ * Like pyi_open_target(), but open file 'name' below status->temppath and
+ * return a file descriptor opened for writing, with permissions for the
+ * owner only. Returns -1 on error.
+ *
+ * If the directories were created by pyi_create_temp_path(), the file is
+ * opened relative to a descriptor of its parent directory, which is kept
+ * open for the next file. Files in the TOC are grouped by directory, so
+ * this is usually a single openat() per file.
+ */
+int
+pyi_open_target_fd(ARCHIVE_STATUS *status, const char *name)
+{
+    char fnm[PATH_MAX];
+    int fd;
+
+#ifdef HAVE_OPENAT
+    const char *base;
+    size_t len;
+    int dirfd;
+
+    if (status->has_target_dirs) {
+        base = strrchr(name, PYI_SEP);
+
+        if (base == NULL) {
+            dirfd = status->tempfd;
+            base = name;
+        }
+        else {
+            len = base - name;
+            base++;
+
+            if (len >= PATH_MAX) {
+                return -1;
+            }
+
+            if (status->lastdirfd < 0 || strncmp(status->lastdir, name, len) != 0 ||
+                status->lastdir[len] != '\0') {
+                if (status->lastdirfd >= 0) {
+                    close(status->lastdirfd);
+                }
+                memcpy(status->lastdir, name, len);
+                status->lastdir[len] = '\0';
+                status->lastdirfd = openat(status->tempfd, status->lastdir,
+                                           O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+                if (status->lastdirfd < 0) {
+                    return -1;
+                }
+            }
+            dirfd = status->lastdirfd;
+        }
+        fd = openat(dirfd, base, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR | S_IXUSR);
+
+        if (fd < 0 && errno == EEXIST) {
+            OTHERERROR("WARNING: file already exists but should not: %s%s%s\n",
+                       status->temppath, PYI_SEPSTR, name);
+            fd = openat(dirfd, base, O_WRONLY | O_TRUNC | O_CLOEXEC);
+        }
+
+        if (fd >= 0) {
+            /* Do not let the umask take the permissions away. */
+            fchmod(fd, S_IRUSR | S_IWUSR | S_IXUSR);
+        }
+        return fd;
+    }
+#endif /* ifdef HAVE_OPENAT */
+
+    if (_prepare_target(fnm, status->temppath, name) < 0) {
+        return -1;
+    }
+    fd = open(fnm, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IXUSR);
+
+    if (fd >= 0) {
+        fchmod(fd, S_IRUSR | S_IWUSR | S_IXUSR);
+    }
+    return fd;
+}
+
+/*
+ * Close the directory descriptors used by pyi_open_target_fd().
+ */
+void
+pyi_close_target_dirs(ARCHIVE_STATUS *status)
+{
+    if (!status->has_target_dirs) {
+        return;
+    }
+
+    if (status->lastdirfd >= 0) {
+        close(status->lastdirfd);
+    }
+    close(status->tempfd);
+    status->has_target_dirs = false;
+}
+
+#endif /* ifndef _WIN32 */
+
 /* Copy the file src to dst 4KB per time */
 int
 pyi_copy_file(const char *src, const char *dst, const char *filename)
@@ -675,14 +1042,15 @@ pyi_utils_set_environment(const ARCHIVE_STATUS *status)
     return 0;
 }
 
+/* Child process started by pyi_utils_spawn_child(). */
+static PROCESS_INFORMATION child_pi;
+
 int
-pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
-                       const int argc, char *const argv[])
+pyi_utils_spawn_child(const char *thisfile, const ARCHIVE_STATUS* status,
+                      const int argc, char *const argv[])
 {
     SECURITY_ATTRIBUTES sa;
     STARTUPINFOW si;
-    PROCESS_INFORMATION pi;
-    int rc = 0;
     wchar_t buffer[PATH_MAX];
 
     /* TODO is there a replacement for this conversion or just use wchar_t everywhere? */
@@ -711,7 +1079,7 @@ pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
 
     VS("LOADER: Creating child process\n");
 
-    if (CreateProcessW(
+    if (!CreateProcessW(
             buffer,            /* Pointer to name of executable module. */
             GetCommandLineW(), /* pointer to command line string */
             &sa,               /* pointer to process security attributes */
@@ -721,19 +1089,35 @@ pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
             NULL,              /* pointer to new environment block */
             NULL,              /* pointer to current directory name */
             &si,               /* pointer to STARTUPINFO */
-            &pi                /* pointer to PROCESS_INFORMATION */
+            &child_pi          /* pointer to PROCESS_INFORMATION */
             )) {
-        VS("LOADER: Waiting for child process to finish...\n");
-        WaitForSingleObject(pi.hProcess, INFINITE);
-        GetExitCodeProcess(pi.hProcess, (unsigned long *)&rc);
-    }
-    else {
         FATAL_WINERROR("CreateProcessW", "Error creating child process!\n");
-        rc = -1;
+        return -1;
     }
+    return 0;
+}
+
+int
+pyi_utils_wait_child(void)
+{
+    int rc = 0;
+
+    VS("LOADER: Waiting for child process to finish...\n");
+    WaitForSingleObject(child_pi.hProcess, INFINITE);
+    GetExitCodeProcess(child_pi.hProcess, (unsigned long *)&rc);
     return rc;
 }
 
+int
+pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
+                       const int argc, char *const argv[])
+{
+    if (pyi_utils_spawn_child(thisfile, status, argc, argv) != 0) {
+        return -1;
+    }
+    return pyi_utils_wait_child();
+}
+
 #else /* ifdef _WIN32 */
 
 static int
@@ -857,6 +1241,20 @@ set_systemd_env()
  */
 pid_t child_pid = 0;
 
+static void
+_free_argv_pyi(void)
+{
+    int i;
+
+    VS("LOADER: freeing args\n");
+    for (i = 0; i < argc_pyi; i++) {
+        free(argv_pyi[i]);
+    }
+    free(argv_pyi);
+    argv_pyi = NULL;
+    argc_pyi = 0;
+}
+
 static void
 _ignoring_signal_handler(int signum)
 {
@@ -870,25 +1268,21 @@ _signal_handler(int signum)
     kill(child_pid, signum);
 }
 
+/* As indicated in signal(7), signal numbers range from 1-31 (standard)
+ * and 32-64 (Linux real-time). */
+#define PYI_NUM_SIGNALS 65
+
 /* Start frozen application in a subprocess. The frozen application runs
- * in a subprocess.
+ * in a subprocess. Signals received by the parent are forwarded to the
+ * child until pyi_utils_wait_child() returns.
  */
 int
-pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
-                       const int argc, char *const argv[])
+pyi_utils_spawn_child(const char *thisfile, const ARCHIVE_STATUS* status,
+                      const int argc, char *const argv[])
 {
     pid_t pid = 0;
-    int rc = 0;
     int i;
 
-    /* cause nonzero return unless this is overwritten
-     * with a successful return code from wait() */
-    int wait_rc = -1;
-
-    /* As indicated in signal(7), signal numbers range from 1-31 (standard)
-     * and 32-64 (Linux real-time). */
-    const size_t num_signals = 65;
-
     sighandler_t handler;
     int ignore_signals;
     int signum;
@@ -917,7 +1311,8 @@ pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
     pid = fork();
     if (pid < 0) {
         VS("LOADER: failed to fork child process: %s\n", strerror(errno));
-        goto cleanup;
+        _free_argv_pyi();
+        return -1;
     }
 
     /* Child code. */
@@ -927,18 +1322,16 @@ pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
             VS("WARNING: Application is started by systemd socket,"
                "but we can't set proper LISTEN_PID on it.\n");
         }
-        if (execvp(thisfile, argv_pyi) < 0) {
-            VS("Failed to exec: %s\n", strerror(errno));
-            goto cleanup;
-        }
-        /* NOTREACHED */
+        execvp(thisfile, argv_pyi);
+        VS("Failed to exec: %s\n", strerror(errno));
+        /* The parent collects this exit code and does the cleanup. */
+        _exit(1);
     }
 
-    /* From here to end-of-function is parent code (since the child exec'd).
-     * The exception is the `cleanup` block that frees argv_pyi; in the child,
-     * wait_rc is -1, so the child exit code checking is skipped. */
+    /* From here to end-of-function is parent code (since the child exec'd). */
 
     child_pid = pid;
+    _free_argv_pyi();
     ignore_signals = (pyi_arch_get_option(status, "pyi-bootloader-ignore-signals") != NULL);
     handler = ignore_signals ? &_ignoring_signal_handler : &_signal_handler;
 
@@ -948,35 +1341,62 @@ pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
     } else {
         VS("LOADER: Registering signal handlers\n");
     }
-    for (signum = 0; signum < num_signals; ++signum) {
+    for (signum = 0; signum < PYI_NUM_SIGNALS; ++signum) {
         // don't mess with SIGCHLD/SIGCLD; it affects our ability
         // to wait() for the child to exit
         if (signum != SIGCHLD && signum != SIGCLD) {
             signal(signum, handler);
         }
     }
+    return 0;
+}
+
+/* Set by pyi_utils_child_exited() once the child has been reaped. */
+static int child_exited = 0;
+static int child_status = 0;
+
+/* Return non-zero if the child started by pyi_utils_spawn_child() has
+ * already exited. Does not block.
+ */
+int
+pyi_utils_child_exited(void)
+{
+    if (!child_exited && waitpid(child_pid, &child_status, WNOHANG) == child_pid) {
+        child_exited = 1;
+    }
+    return child_exited;
+}
+
+/* Wait for the child started by pyi_utils_spawn_child() and return its
+ * exit code.
+ */
+int
+pyi_utils_wait_child(void)
+{
+    int rc = child_status;
+    int signum;
+
+    /* cause nonzero return unless this is overwritten
+     * with a successful return code from wait() */
+    int wait_rc = child_pid;
 
-    wait_rc = waitpid(child_pid, &rc, 0);
+    if (!child_exited) {
+        wait_rc = waitpid(child_pid, &rc, 0);
+    }
     if (wait_rc < 0) {
         VS("LOADER: failed to wait for child process: %s\n", strerror(errno));
     }
 
     /* When child process exited, reset signal handlers to default values. */
     VS("LOADER: Restoring signal handlers\n");
-    for (signum = 0; signum < num_signals; ++signum) {
+    for (signum = 0; signum < PYI_NUM_SIGNALS; ++signum) {
         signal(signum, SIG_DFL);
     }
 
-  cleanup:
-    VS("LOADER: freeing args\n");
-    for (i = 0; i < argc_pyi; i++) {
-        free(argv_pyi[i]);
-    }
-    free(argv_pyi);
+    _free_argv_pyi();
 
-    /* Either wait() failed, or we jumped to `cleanup` and
-     * didn't wait() at all. Either way, exit with error,
-     * because rc does not contain a valid process exit code. */
+    /* wait() failed, exit with error, because rc does not contain a valid
+     * process exit code. */
     if (wait_rc < 0) {
         VS("LOADER: exiting early\n");
         return 1;
@@ -996,6 +1416,18 @@ pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
     return 1;
 }
 
+/* Start frozen application in a subprocess and wait for it to exit. */
+int
+pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS* status,
+                       const int argc, char *const argv[])
+{
+    if (pyi_utils_spawn_child(thisfile, status, argc, argv) != 0) {
+        VS("LOADER: exiting early\n");
+        return 1;
+    }
+    return pyi_utils_wait_child();
+}
+
 /*
  * On Mac OS X this converts files from kAEOpenDocuments events into sys.argv.
  */
@@ -28,15 +28,30 @@ int pyi_unsetenv(const char *variable);
 
 int pyi_create_temp_path(ARCHIVE_STATUS *status);
 void pyi_remove_temp_path(const char *dir);
+#ifndef _WIN32
+int pyi_remove_temp_path_detached(const char *dir);
+#endif
 
 /* File manipulation. */
 FILE *pyi_open_target(const char *path, const char* name_);
+#ifndef _WIN32
+int pyi_open_target_fd(ARCHIVE_STATUS *status, const char *name);
+void pyi_close_target_dirs(ARCHIVE_STATUS *status);
+#endif
 int pyi_copy_file(const char *src, const char *dst, const char *filename);
 
 /* Other routines. */
 dylib_t pyi_utils_dlopen(const char *dllpath);
 int pyi_utils_create_child(const char *thisfile, const ARCHIVE_STATUS *status,
                            const int argc, char *const argv[]);
+/* pyi_utils_create_child() in two steps, for work done while the child runs. */
+int pyi_utils_spawn_child(const char *thisfile, const ARCHIVE_STATUS *status,
+                          const int argc, char *const argv[]);
+int pyi_utils_wait_child(void);
+#ifndef _WIN32
+int pyi_utils_child_exited(void);
+int pyi_utils_fork_detached(void);
+#endif
 int pyi_utils_set_environment(const ARCHIVE_STATUS *status);
 
 #endif  /* HEADER_PY_UTILS_H */
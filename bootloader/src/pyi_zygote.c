@@ -0,0 +1,919 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Fork-server ("zygote") mode (POSIX only).
+ *
+ * The first invocation of an application built with zygote mode starts a
+ * detached copy of itself as server and then runs as usual. The server
+ * initializes Python, runs the bootstrap script, imports the modules listed
+ * in the pyi-zygote option and listens on a Unix socket in a private
+ * per-user directory. The socket name is derived from the path, size and
+ * modification time of the executable, so a rebuilt application gets a new
+ * server.
+ *
+ * Later invocations connect to the socket and send their working directory,
+ * arguments, environment, umask and resource limits, with their standard
+ * streams as SCM_RIGHTS.
+ * For every request the server forks a handler, which forks the worker that
+ * runs the rest of the application. The handler forwards the signals the
+ * client receives to the worker and returns its wait status to the client.
+ */
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <limits.h>      /* PATH_MAX */
+#include <netinet/in.h>  /* htonl, ntohl */
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>      /* uint32_t, uint64_t */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>  /* getrlimit, setrlimit */
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_utils.h"
+#include "pyi_python.h"
+#include "pyi_pythonlib.h"
+#include "pyi_zygote.h"
+
+extern char **environ;
+
+/* Set to the socket path in the environment of the server. */
+#define ZYGOTE_ENV      "_PYI_ZYGOTE"
+
+/* First word of a request: "PYIZ". */
+#define ZYGOTE_MAGIC    0x5059495aU
+
+/* Sent by the handler once the worker is running. */
+#define ZYGOTE_STARTED  'R'
+
+#define SUN_PATH_SIZE   sizeof(((struct sockaddr_un *) 0)->sun_path)
+
+/* Signals the client forwards to the worker. */
+static const int _forwarded_signals[] = {
+    SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGUSR1, SIGUSR2,
+#ifdef SIGWINCH
+    SIGWINCH,
+#endif
+};
+#define NUM_FORWARDED_SIGNALS \
+    (sizeof(_forwarded_signals) / sizeof(_forwarded_signals[0]))
+
+/* Resource limits the worker takes over from the client. */
+static const int _client_rlimits[] = {
+    RLIMIT_CORE, RLIMIT_CPU, RLIMIT_DATA, RLIMIT_FSIZE, RLIMIT_NOFILE,
+    RLIMIT_STACK,
+#ifdef RLIMIT_AS
+    RLIMIT_AS,
+#endif
+#ifdef RLIMIT_NPROC
+    RLIMIT_NPROC,
+#endif
+};
+#define NUM_CLIENT_RLIMITS \
+    (sizeof(_client_rlimits) / sizeof(_client_rlimits[0]))
+
+/*
+ * Words of the request header: magic, argc, number of environment strings,
+ * length of the strings, umask, then for each of _client_rlimits the soft
+ * and the hard limit as two words each (high word first).
+ */
+#define HDR_MAGIC    0
+#define HDR_ARGC     1
+#define HDR_ENVC     2
+#define HDR_LEN      3
+#define HDR_UMASK    4
+#define HDR_RLIMITS  5
+#define HDR_WORDS    (HDR_RLIMITS + 4 * NUM_CLIENT_RLIMITS)
+
+static int _client_sock = -1;
+static int _chld_pipe[2] = { -1, -1 };
+
+int
+pyi_zygote_is_enabled(const ARCHIVE_STATUS *status)
+{
+    return pyi_arch_get_option(status, "pyi-zygote") != NULL;
+}
+
+int
+pyi_zygote_is_server(void)
+{
+    char *path = pyi_getenv(ZYGOTE_ENV);
+
+    free(path);
+    return path != NULL;
+}
+
+/* FNV-1a, to derive the socket name. */
+static uint64_t
+_hash(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    while (len--) {
+        hash = (hash ^ *p++) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * Write the socket path of 'executable' to 'buf'. The socket lives in a
+ * directory only the current user can access, which is created if needed.
+ */
+static int
+_socket_path(char *buf, size_t size, const char *executable)
+{
+    char dir[PATH_MAX];
+    struct stat sb;
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t stamp[3];
+    const char *tmp = getenv("XDG_RUNTIME_DIR");
+
+    if (stat(executable, &sb) != 0) {
+        return -1;
+    }
+    stamp[0] = (uint64_t) sb.st_size;
+    stamp[1] = (uint64_t) sb.st_mtime;
+    stamp[2] = (uint64_t) sb.st_ino;
+    hash = _hash(hash, executable, strlen(executable));
+    hash = _hash(hash, stamp, sizeof(stamp));
+
+    if (tmp == NULL || tmp[0] == '\0') {
+        tmp = getenv("TMPDIR");
+    }
+
+    if (tmp == NULL || tmp[0] == '\0') {
+        tmp = "/tmp";
+    }
+
+    if (snprintf(dir, PATH_MAX, "%s/pyi-zygote-%lu", tmp,
+                 (unsigned long) getuid()) >= PATH_MAX) {
+        return -1;
+    }
+    mkdir(dir, S_IRWXU);
+
+    if (lstat(dir, &sb) != 0 || !S_ISDIR(sb.st_mode) || sb.st_uid != getuid() ||
+        (sb.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+        VS("LOADER: Not using %s for the zygote socket\n", dir);
+        return -1;
+    }
+
+    if (snprintf(buf, size, "%s/%016llx", dir,
+                 (unsigned long long) hash) >= (int) size) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_send_all(int fd, const char *data, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, data, len);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int
+_recv_all(int fd, char *data, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(fd, data, len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* The request header (see HDR_WORDS) is sent with the standard streams. */
+static int
+_send_header(int sock, uint32_t *header)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    int fds[3] = { 0, 1, 2 };
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = header;
+    iov.iov_len = HDR_WORDS * sizeof(uint32_t);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    do {
+        n = sendmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+
+    return n == (ssize_t) iov.iov_len ? 0 : -1;
+}
+
+static int
+_recv_header(int sock, uint32_t *header, int *fds)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = header;
+    iov.iov_len = HDR_WORDS * sizeof(uint32_t);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    do {
+        n = recvmsg(sock, &msg, MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+
+    if (n != (ssize_t) iov.iov_len || (msg.msg_flags & MSG_CTRUNC) || cmsg == NULL ||
+        cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    return 0;
+}
+
+static void
+_put_rlim(uint32_t *words, rlim_t value)
+{
+    uint64_t v = (uint64_t) value;
+
+    words[0] = htonl((uint32_t) (v >> 32));
+    words[1] = htonl((uint32_t) v);
+}
+
+static rlim_t
+_get_rlim(const uint32_t *words)
+{
+    return (rlim_t) (((uint64_t) ntohl(words[0]) << 32) | ntohl(words[1]));
+}
+
+/*
+ * Pack the working directory, the arguments and the environment as
+ * NUL-terminated strings and fill in the request header.
+ */
+static char *
+_pack_request(int argc, char *const argv[], uint32_t *header)
+{
+    char cwd[PATH_MAX];
+    struct rlimit rl;
+    size_t len, n;
+    int envc, i;
+    mode_t mask;
+    char *payload, *p;
+
+    if (getcwd(cwd, PATH_MAX) == NULL) {
+        return NULL;
+    }
+    len = strlen(cwd) + 1;
+
+    for (i = 0; i < argc; i++) {
+        len += strlen(argv[i]) + 1;
+    }
+
+    for (envc = 0; environ[envc] != NULL; envc++) {
+        len += strlen(environ[envc]) + 1;
+    }
+    payload = (char *) malloc(len);
+
+    if (payload == NULL) {
+        return NULL;
+    }
+    n = strlen(cwd) + 1;
+    memcpy(payload, cwd, n);
+    p = payload + n;
+
+    for (i = 0; i < argc; i++) {
+        n = strlen(argv[i]) + 1;
+        memcpy(p, argv[i], n);
+        p += n;
+    }
+
+    for (i = 0; i < envc; i++) {
+        n = strlen(environ[i]) + 1;
+        memcpy(p, environ[i], n);
+        p += n;
+    }
+    header[HDR_MAGIC] = htonl(ZYGOTE_MAGIC);
+    header[HDR_ARGC] = htonl((uint32_t) argc);
+    header[HDR_ENVC] = htonl((uint32_t) envc);
+    header[HDR_LEN] = htonl((uint32_t) len);
+
+    mask = umask(0);
+    umask(mask);
+    header[HDR_UMASK] = htonl((uint32_t) mask);
+
+    for (i = 0; i < (int) NUM_CLIENT_RLIMITS; i++) {
+        if (getrlimit(_client_rlimits[i], &rl) != 0) {
+            free(payload);
+            return NULL;
+        }
+        _put_rlim(header + HDR_RLIMITS + 4 * i, rl.rlim_cur);
+        _put_rlim(header + HDR_RLIMITS + 4 * i + 2, rl.rlim_max);
+    }
+    return payload;
+}
+
+/* Split 'count' strings off the packed request into a NULL-terminated list. */
+static char **
+_unpack_strings(char **pos, const char *end, uint32_t count)
+{
+    char **list;
+    size_t n;
+    uint32_t i;
+
+    if (count > (uint32_t) (end - *pos)) {
+        return NULL;
+    }
+    list = (char **) calloc(count + 1, sizeof(char *));
+
+    if (list == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        n = strnlen(*pos, end - *pos);
+
+        if (*pos + n >= end) {
+            free(list);
+            return NULL;
+        }
+        list[i] = *pos;
+        *pos += n + 1;
+    }
+    return list;
+}
+
+static void
+_forward_signal(int signum)
+{
+    unsigned char c = (unsigned char) signum;
+    int saved_errno = errno;
+
+    if (write(_client_sock, &c, 1) < 0) {
+        /* The worker gets SIGHUP when the connection is closed. */
+    }
+    errno = saved_errno;
+}
+
+int
+pyi_zygote_run(const char *executable, int argc, char *const argv[], int *rc)
+{
+    struct sockaddr_un addr;
+    struct sigaction sa, old_pipe;
+    struct sigaction old_sa[NUM_FORWARDED_SIGNALS];
+    uint32_t header[HDR_WORDS], result;
+    char *payload;
+    char started = 0;
+    int sock, wstatus;
+    size_t i;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (_socket_path(addr.sun_path, SUN_PATH_SIZE, executable) != 0) {
+        return -1;
+    }
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0) {
+        return -1;
+    }
+
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        VS("LOADER: No zygote server at %s\n", addr.sun_path);
+        close(sock);
+        return -1;
+    }
+    VS("LOADER: Connected to zygote server %s\n", addr.sun_path);
+
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, &old_pipe);
+
+    payload = _pack_request(argc, argv, header);
+
+    /* Until the server confirms the start, fall back to a normal start. */
+    if (payload == NULL || _send_header(sock, header) != 0 ||
+        _send_all(sock, payload, ntohl(header[HDR_LEN])) != 0 ||
+        _recv_all(sock, &started, 1) != 0 || started != ZYGOTE_STARTED) {
+        VS("LOADER: Zygote server did not accept the request\n");
+        free(payload);
+        close(sock);
+        sigaction(SIGPIPE, &old_pipe, NULL);
+        return -1;
+    }
+    free(payload);
+
+    _client_sock = sock;
+    sa.sa_handler = _forward_signal;
+
+    for (i = 0; i < NUM_FORWARDED_SIGNALS; i++) {
+        sigaction(_forwarded_signals[i], &sa, &old_sa[i]);
+    }
+
+    if (_recv_all(sock, (char *) &result, sizeof(result)) != 0) {
+        FATALERROR("Lost connection to the zygote server\n");
+        result = htonl(1 << 8);  /* exit status 1 */
+    }
+
+    for (i = 0; i < NUM_FORWARDED_SIGNALS; i++) {
+        sigaction(_forwarded_signals[i], &old_sa[i], NULL);
+    }
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    close(sock);
+    _client_sock = -1;
+
+    wstatus = (int) ntohl(result);
+
+    if (WIFEXITED(wstatus)) {
+        VS("LOADER: returning worker exit status %d\n", WEXITSTATUS(wstatus));
+        *rc = WEXITSTATUS(wstatus);
+        return 0;
+    }
+
+    if (WIFSIGNALED(wstatus)) {
+        VS("LOADER: re-raising worker signal %d\n", WTERMSIG(wstatus));
+        raise(WTERMSIG(wstatus));
+    }
+    *rc = 1;
+    return 0;
+}
+
+void
+pyi_zygote_start_server(const char *executable)
+{
+    char path[SUN_PATH_SIZE];
+
+    if (_socket_path(path, SUN_PATH_SIZE, executable) != 0) {
+        return;
+    }
+
+    if (pyi_utils_fork_detached() == 0) {
+        if (pyi_setenv(ZYGOTE_ENV, path) == 0) {
+            execl(executable, executable, (char *) NULL);
+        }
+        _exit(1);
+    }
+    VS("LOADER: Starting zygote server at %s\n", path);
+}
+
+/*
+ * Bind the listening socket. An existing socket is replaced only if no
+ * server accepts connections on it.
+ */
+static int
+_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int sock, probe;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, SUN_PATH_SIZE - 1);
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0) {
+        return -1;
+    }
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        probe = errno == EADDRINUSE ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+
+        if (probe < 0 || connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            VS("LOADER: Zygote server already running at %s\n", path);
+            if (probe >= 0) {
+                close(probe);
+            }
+            close(sock);
+            return -1;
+        }
+        close(probe);
+        unlink(path);
+
+        if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            close(sock);
+            return -1;
+        }
+    }
+
+    if (listen(sock, 64) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* Import the modules listed in the pyi-zygote option. */
+static void
+_preload_modules(ARCHIVE_STATUS *status)
+{
+    char *modules = pyi_arch_get_option(status, "pyi-zygote");
+    char *name;
+    PyObject *module;
+
+    if (modules == NULL || modules[0] == '\0' || (modules = strdup(modules)) == NULL) {
+        return;
+    }
+
+    for (name = strtok(modules, ","); name != NULL; name = strtok(NULL, ",")) {
+        VS("LOADER: Preloading module %s\n", name);
+        module = PI_PyImport_ImportModule(name);
+
+        if (module == NULL) {
+            VS("LOADER: Failed to preload module %s\n", name);
+            PI_PyErr_Clear();
+        }
+        else {
+            Py_DECREF(module);
+        }
+    }
+    free(modules);
+}
+
+static void
+_chld_handler(int signum)
+{
+    char c = 0;
+    int saved_errno = errno;
+
+    if (write(_chld_pipe[1], &c, 1) < 0) {
+        /* The pipe is full, the handler is already woken up. */
+    }
+    errno = saved_errno;
+}
+
+/*
+ * Return non-zero if the worker can take over the client's resource limits
+ * from the request header: an unprivileged process cannot raise its hard
+ * limits. The client starts the application itself otherwise.
+ */
+static int
+_can_set_rlimits(const uint32_t *header)
+{
+    struct rlimit rl;
+    size_t i;
+
+    for (i = 0; i < NUM_CLIENT_RLIMITS; i++) {
+        if (getrlimit(_client_rlimits[i], &rl) != 0) {
+            return 0;
+        }
+
+        if (rl.rlim_max != RLIM_INFINITY &&
+            _get_rlim(header + HDR_RLIMITS + 4 * i + 2) > rl.rlim_max) {
+            VS("LOADER: Cannot raise resource limit %d for the worker\n",
+               _client_rlimits[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Install the client's umask and resource limits in the worker. */
+static void
+_set_client_limits(const uint32_t *header)
+{
+    struct rlimit rl;
+    size_t i;
+
+    umask((mode_t) ntohl(header[HDR_UMASK]));
+
+    for (i = 0; i < NUM_CLIENT_RLIMITS; i++) {
+        rl.rlim_cur = _get_rlim(header + HDR_RLIMITS + 4 * i);
+        rl.rlim_max = _get_rlim(header + HDR_RLIMITS + 4 * i + 2);
+
+        if (setrlimit(_client_rlimits[i], &rl) != 0) {
+            VS("LOADER: Cannot set resource limit %d\n", _client_rlimits[i]);
+        }
+    }
+}
+
+/*
+ * Handle one request in a process forked from the server. Starts the worker
+ * and only returns in it, after installing the client's state. The handler
+ * itself waits for the worker and exits.
+ */
+static void
+_handle_request(int conn, ARCHIVE_STATUS *status)
+{
+    uint32_t header[HDR_WORDS], result;
+    int fds[3];
+    size_t len;
+    char *payload, *pos, *cwd;
+    char **argv, **envp;
+    char buf[64];
+    ssize_t n;
+    int i, wstatus = 1 << 8;
+    pid_t pid;
+    struct pollfd pfd[2];
+    struct sigaction sa;
+
+    if (_recv_header(conn, header, fds) != 0 ||
+        ntohl(header[HDR_MAGIC]) != ZYGOTE_MAGIC || !_can_set_rlimits(header)) {
+        _exit(1);
+    }
+    len = ntohl(header[HDR_LEN]);
+    payload = (char *) malloc(len + 1);
+
+    if (payload == NULL || _recv_all(conn, payload, len) != 0) {
+        _exit(1);
+    }
+    payload[len] = '\0';
+    pos = payload;
+    cwd = pos;
+    pos += strlen(cwd) + 1;
+    argv = _unpack_strings(&pos, payload + len, ntohl(header[HDR_ARGC]));
+    envp = _unpack_strings(&pos, payload + len, ntohl(header[HDR_ENVC]));
+
+    if (argv == NULL || envp == NULL || pipe(_chld_pipe) != 0) {
+        _exit(1);
+    }
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = _chld_handler;
+    sa.sa_flags = SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    if (PI_PyOS_BeforeFork) {
+        PI_PyOS_BeforeFork();
+    }
+    pid = fork();
+
+    if (pid == 0) {
+        /* Worker. */
+        if (PI_PyOS_AfterFork_Child) {
+            PI_PyOS_AfterFork_Child();
+        }
+        else {
+            PI_PyOS_AfterFork();
+        }
+        signal(SIGCHLD, SIG_DFL);
+        close(_chld_pipe[0]);
+        close(_chld_pipe[1]);
+        close(conn);
+
+        for (i = 0; i < 3; i++) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+
+        if (chdir(cwd) != 0) {
+            VS("LOADER: Cannot change to directory %s\n", cwd);
+        }
+        _set_client_limits(header);
+        environ = envp;
+        status->argc = (int) ntohl(header[HDR_ARGC]);
+        status->argv = argv;
+        return;
+    }
+
+    if (PI_PyOS_AfterFork_Parent) {
+        PI_PyOS_AfterFork_Parent();
+    }
+
+    for (i = 0; i < 3; i++) {
+        close(fds[i]);
+    }
+
+    if (pid < 0) {
+        _exit(1);
+    }
+    buf[0] = ZYGOTE_STARTED;
+    _send_all(conn, buf, 1);
+
+    pfd[0].fd = _chld_pipe[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = conn;
+    pfd[1].events = POLLIN;
+
+    while (waitpid(pid, &wstatus, WNOHANG) != pid) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            waitpid(pid, &wstatus, 0);
+            break;
+        }
+
+        if (pfd[0].revents) {
+            n = read(_chld_pipe[0], buf, sizeof(buf));
+        }
+
+        if (pfd[1].revents) {
+            n = read(conn, buf, sizeof(buf));
+
+            if (n <= 0) {
+                /* The client is gone, like a closed terminal. */
+                kill(pid, SIGHUP);
+                pfd[1].fd = -1;
+            }
+
+            for (i = 0; i < n; i++) {
+                kill(pid, (unsigned char) buf[i]);
+            }
+        }
+    }
+    result = htonl((uint32_t) wstatus);
+    _send_all(conn, (char *) &result, sizeof(result));
+    _exit(0);
+}
+
+int
+pyi_zygote_serve(ARCHIVE_STATUS *status)
+{
+    char *path = pyi_getenv(ZYGOTE_ENV);
+    struct stat sb, sb_now;
+    struct pollfd pfd;
+    int sock, conn, rc, active = 0;
+    pid_t pid;
+
+    /* Applications started by the workers are not servers. */
+    pyi_unsetenv(ZYGOTE_ENV);
+
+    if (path == NULL) {
+        return 0;
+    }
+
+    if ((!PI_PyOS_AfterFork_Child && !PI_PyOS_AfterFork) ||
+        (sock = _listen(path)) < 0 || stat(path, &sb) != 0) {
+        VS("LOADER: Cannot serve at %s\n", path);
+        free(path);
+        return 0;
+    }
+    _preload_modules(status);
+
+    /* Keep the preloaded objects out of the garbage collector, so that the
+     * workers keep sharing their memory pages with the server. */
+    PI_PyRun_SimpleString("import gc\n"
+                          "if hasattr(gc, 'freeze'):\n"
+                          "    gc.freeze()\n");
+
+    VS("LOADER: Zygote server listening at %s\n", path);
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        while (active > 0 && waitpid(-1, NULL, WNOHANG) > 0) {
+            active--;
+        }
+        /* Do not exit while workers still use the extracted files. */
+        rc = poll(&pfd, 1, active ? 1000 : PYI_ZYGOTE_IDLE_TIMEOUT * 1000);
+
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (rc < 0 || (rc == 0 && active == 0)) {
+            break;
+        }
+
+        if (rc == 0) {
+            continue;
+        }
+        conn = accept(sock, NULL, NULL);
+
+        if (conn < 0) {
+            continue;
+        }
+        pid = fork();
+
+        if (pid == 0) {
+            close(sock);
+            free(path);
+            _handle_request(conn, status);
+            return 1;
+        }
+
+        if (pid > 0) {
+            active++;
+        }
+        close(conn);
+    }
+    VS("LOADER: Zygote server idle, exiting\n");
+
+    /* Remove the socket unless another server has replaced it. */
+    if (stat(path, &sb_now) == 0 && sb_now.st_ino == sb.st_ino &&
+        sb_now.st_dev == sb.st_dev) {
+        unlink(path);
+    }
+    close(sock);
+    free(path);
+    return 0;
+}
+
+/*
+ * os.environ was created when the server started: replace its contents with
+ * the client's environment, in place since modules may hold references.
+ * The C environment is already the client's, so putenv() is not needed.
+ */
+static const char _worker_init[] =
+    "import os as _os, sys as _sys\n"
+    "_os.environ._data.clear()\n"
+    "for _e in _sys._pyi_zygote_environ:\n"
+    "    _k, _s, _v = _e.partition('=')\n"
+    "    _os.environ._data[_os.environ.encodekey(_k)] = _os.environ.encodevalue(_v)\n"
+    "del _sys._pyi_zygote_environ\n"
+    "for _f in (_sys.stdout, _sys.stderr):\n"
+    "    if _f is not None and hasattr(_f, 'reconfigure') and _f.isatty():\n"
+    "        _f.reconfigure(line_buffering=True)\n"
+    "del _os, _sys\n";
+
+int
+pyi_zygote_init_worker(ARCHIVE_STATUS *status)
+{
+    PyObject *env, *entry;
+    char **p;
+
+    if (pyi_pylib_set_sys_argv(status)) {
+        return -1;
+    }
+    env = PI_PyList_New(0);
+
+    if (env == NULL) {
+        return -1;
+    }
+
+    for (p = environ; *p != NULL; p++) {
+        entry = PI_PyUnicode_DecodeFSDefault(*p);
+
+        if (entry == NULL || PI_PyList_Append(env, entry) < 0) {
+            if (entry != NULL) {
+                PI_Py_DecRef(entry);
+            }
+            PI_Py_DecRef(env);
+            return -1;
+        }
+        PI_Py_DecRef(entry);
+    }
+
+    if (PI_PySys_SetObject("_pyi_zygote_environ", env) < 0) {
+        PI_Py_DecRef(env);
+        return -1;
+    }
+    PI_Py_DecRef(env);
+    return PI_PyRun_SimpleString((char *) _worker_init) != 0 ? -1 : 0;
+}
+
+#endif /* ifndef _WIN32 */
@@ -0,0 +1,60 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2019, PyInstaller Development Team.
+ * Distributed under the terms of the GNU General Public License with exception
+ * for distributing bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ * ****************************************************************************
+ */
+
+/*
+ * Fork-server ("zygote") mode (POSIX only).
+ *
+ * A server process keeps an initialized interpreter with preloaded modules
+ * and listens on a per-user Unix socket. Later invocations of the same
+ * executable pass their arguments, environment, working directory and
+ * standard streams to the server and the application runs in a fork of it.
+ */
+
+#ifndef PYI_ZYGOTE_H
+#define PYI_ZYGOTE_H
+
+#include "pyi_archive.h"
+
+#ifndef _WIN32
+
+/* Seconds the server waits for the next invocation before it exits. */
+#define PYI_ZYGOTE_IDLE_TIMEOUT  600
+
+/* Return non-zero if the application was built with zygote mode. */
+int pyi_zygote_is_enabled(const ARCHIVE_STATUS *status);
+
+/* Return non-zero in the server process (and its bootloader parent). */
+int pyi_zygote_is_server(void);
+
+/*
+ * Run the application in a running server. Returns 0 if it was run there,
+ * with its exit code in 'rc', or -1 if no server accepted the request and
+ * the application has to be started as usual.
+ */
+int pyi_zygote_run(const char *executable, int argc, char *const argv[], int *rc);
+
+/* Start a server for 'executable' in the background. */
+void pyi_zygote_start_server(const char *executable);
+
+/*
+ * Serve requests until the server has been idle for PYI_ZYGOTE_IDLE_TIMEOUT
+ * seconds; Python must be initialized and the bootstrap script run.
+ *
+ * Returns 0 in the server when it is done, and 1 in a forked worker, with
+ * the environment, standard streams and status->argv of the client.
+ */
+int pyi_zygote_serve(ARCHIVE_STATUS *status);
+
+/* Set sys.argv, os.environ and the standard streams of a worker. */
+int pyi_zygote_init_worker(ARCHIVE_STATUS *status);
+
+#endif /* ifndef _WIN32 */
+
+#endif  /* PYI_ZYGOTE_H */
@@ -59,6 +59,70 @@ local uLong adler32_combine_ OF((uLong adler1, uLong adler2, z_off64_t len2));
 #  define MOD63(a) a %= BASE
 #endif
 
+/* SSE2 is part of the x86-64 baseline and of most 32-bit x86 targets, so it
+   is selected at compile time without a run time CPU check */
+#if !defined(ADLER32_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define ADLER32_SSE2
+#  include <emmintrin.h>
+
+local unsigned long hsum32 OF((__m128i v));
+local void adler32_sse2 OF((unsigned long *padler, unsigned long *psum2,
+                            const Bytef *buf, z_size_t len));
+
+/* sum of the four 32-bit lanes of v */
+local unsigned long hsum32(v)
+    __m128i v;
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned long)(unsigned)_mm_cvtsi128_si32(v);
+}
+
+/* Update the reduced sums *padler and *psum2 with len bytes, len a multiple
+   of 16. For each 16-byte block starting with sums a and b, a grows by the
+   sum of the bytes and b by 16 * a plus the bytes weighted 16, 15, ..., 1.
+   The block sums are accumulated in vector lanes for up to NMAX bytes. */
+local void adler32_sse2(padler, psum2, buf, len)
+    unsigned long *padler;
+    unsigned long *psum2;
+    const Bytef *buf;
+    z_size_t len;
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+    const __m128i w_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+    unsigned long adler = *padler;
+    unsigned long sum2 = *psum2;
+    __m128i vs1, vs1_sum, vs2, v;
+    z_size_t n;
+
+    while (len) {
+        n = len < NMAX ? len : NMAX;    /* NMAX is divisible by 16 */
+        len -= n;
+        sum2 += adler * (unsigned long)n;
+        vs1 = vs1_sum = vs2 = zero;
+        do {
+            v = _mm_loadu_si128((const __m128i *)buf);
+            vs1_sum = _mm_add_epi32(vs1_sum, vs1);
+            vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(v, zero));
+            vs2 = _mm_add_epi32(vs2,
+                                _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), w_lo));
+            vs2 = _mm_add_epi32(vs2,
+                                _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), w_hi));
+            buf += 16;
+            n -= 16;
+        } while (n);
+        adler += hsum32(vs1);
+        sum2 += ((hsum32(vs1_sum) % BASE) << 4) + hsum32(vs2);
+        MOD(adler);
+        MOD(sum2);
+    }
+    *padler = adler;
+    *psum2 = sum2;
+}
+#endif
+
 /* ========================================================================= */
 uLong ZEXPORT adler32_z(adler, buf, len)
     uLong adler;
@@ -99,6 +163,13 @@ uLong ZEXPORT adler32_z(adler, buf, len)
         return adler | (sum2 << 16);
     }
 
+#ifdef ADLER32_SSE2
+    /* do the 16-byte blocks with SSE2, the rest below */
+    adler32_sse2(&adler, &sum2, buf, len & ~(z_size_t)15);
+    buf += len & ~(z_size_t)15;
+    len &= 15;
+#endif
+
     /* do length NMAX blocks -- requires just one modulo operation */
     while (len >= NMAX) {
         len -= NMAX;
@@ -12,6 +12,13 @@
 #  pragma message("Assembler code may have bugs -- use at your own risk")
 #else
 
+/* type of the local bit buffer, see INFLATE_FAST_WIDE in inffast.h */
+#ifdef INFLATE_FAST_WIDE
+typedef unsigned long long bitbuf_t;
+#else
+typedef unsigned long bitbuf_t;
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -64,7 +71,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     unsigned whave;             /* valid bytes in the window */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
-    unsigned long hold;         /* local strm->hold */
+    bitbuf_t hold;              /* local strm->hold */
     unsigned bits;              /* local strm->bits */
     code const FAR *lcode;      /* local strm->lencode */
     code const FAR *dcode;      /* local strm->distcode */
@@ -80,7 +87,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
     out = strm->next_out;
     beg = out - (start - strm->avail_out);
     end = out + (strm->avail_out - 257);
@@ -101,12 +108,26 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#ifdef INFLATE_FAST_WIDE
+        /* fill hold to at least 56 bits with one load, enough for a length
+           and a distance code with their extra bits, so the refills below
+           never happen; the bits above bits are the low bits of the next
+           input byte and are or-ed in again by the next load */
+        {
+            bitbuf_t next;
+            zmemcpy(&next, in, 8);
+            hold |= next << bits;
+            in += (63 - bits) >> 3;
+            bits |= 56;
+        }
+#else
         if (bits < 15) {
             hold += (unsigned long)(*in++) << bits;
             bits += 8;
             hold += (unsigned long)(*in++) << bits;
             bits += 8;
         }
+#endif
         here = lcode[hold & lmask];
       dolen:
         op = (unsigned)(here.bits);
@@ -250,6 +271,25 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                 }
                 else {
                     from = out - dist;          /* copy direct from output */
+#ifdef INFLATE_FAST_WIDE
+                    if (dist >= 8 && len + 7 <= (unsigned)(end - out) + 257) {
+                        /* eight bytes at a time, may write up to seven
+                           bytes past the match but not past the buffer */
+                        unsigned char FAR *stop = out + len;
+                        do {
+                            zmemcpy(out, from, 8);
+                            out += 8;
+                            from += 8;
+                        } while (out < stop);
+                        out = stop;
+                        continue;
+                    }
+                    if (dist == 1) {            /* run of one byte */
+                        memset(out, out[-1], len);
+                        out += len;
+                        continue;
+                    }
+#endif
                     do {                        /* minimum length is three */
                         *out++ = *from++;
                         *out++ = *from++;
@@ -289,7 +329,8 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
         }
     } while (in < last && out < end);
 
-    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    /* return unused bytes (on entry, bits < 8, so in won't go too far back;
+       with INFLATE_FAST_WIDE this can be up to seven bytes) */
     len = bits >> 3;
     in -= len;
     bits -= len << 3;
@@ -298,7 +339,9 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* update state and return */
     strm->next_in = in;
     strm->next_out = out;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
                                  257 + (end - out) : 257 - (out - end));
     state->hold = hold;
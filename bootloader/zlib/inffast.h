@@ -9,3 +9,16 @@
  */
 
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
+
+/* On 64-bit little-endian targets inflate_fast() refills its bit buffer with
+   one unaligned 8-byte load per code and copies matches eight bytes at a
+   time. It then needs eight bytes of input instead of six to start. */
+#if !defined(INFLATE_FAST_NO_WIDE) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(_M_ARM64) || \
+     (defined(__aarch64__) && defined(__BYTE_ORDER__) && \
+      __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#  define INFLATE_FAST_WIDE
+#  define INFLATE_FAST_MIN_HAVE 8
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#endif
@@ -0,0 +1,15 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2019, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+
+# One of the entry points of pyi_entrypoints.spec, see test_entrypoints.
+
+import os
+import sys
+
+print(' '.join(['pyi_entrypoint_a', os.path.basename(sys.argv[0])] + sys.argv[1:]))
@@ -0,0 +1,32 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2019, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+
+
+# Built by pyi_lazy_modules.spec: 'json' is lazy, 'json.tool' is excluded.
+
+import sys
+import types
+
+import json
+import json.tool
+
+# Importing the submodule ran the package.
+assert type(sys.modules['json']) is types.ModuleType
+assert type(sys.modules['json.tool']) is types.ModuleType
+
+import csv
+# Not run yet, also not when imported again.
+assert type(sys.modules['csv']) is not types.ModuleType, type(csv)
+import csv
+assert type(sys.modules['csv']) is not types.ModuleType, type(csv)
+
+# The first attribute access runs the module.
+assert csv.QUOTE_ALL == 1
+assert type(sys.modules['csv']) is types.ModuleType
+assert json.dumps([1]) == '[1]'
@@ -0,0 +1,34 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2019, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+
+
+# Built by pyi_zygote.spec: the zygote server preloads 'csv'. If
+# PYI_ZYGOTE_RESULT is set, the state of the process is written to that
+# file. The exit status is the first argument.
+
+import os
+import resource
+import sys
+
+result = os.environ.get('PYI_ZYGOTE_RESULT')
+if result:
+    mask = os.umask(0)
+    os.umask(mask)
+    state = {
+        'preloaded': 'csv' in sys.modules,
+        'cwd': os.getcwd(),
+        'argv': sys.argv[1:],
+        'value': os.environ.get('PYI_ZYGOTE_VALUE'),
+        'umask': mask,
+        'nofile': resource.getrlimit(resource.RLIMIT_NOFILE)[0],
+    }
+    with open(result, 'w') as fp:
+        fp.write(repr(state))
+
+sys.exit(int(sys.argv[1]) if len(sys.argv) > 1 else 0)
@@ -0,0 +1,30 @@
+# -*- mode: python -*-
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2019, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+
+# One executable for two programs, selected by the name it is started as or
+# by the first argument.
+
+app_name = "pyi_entrypoints"
+
+a = Analysis(['../scripts/pyi_entrypoint_a.py',
+              '../scripts/pyi_entrypoint_b.py'])
+pyz = PYZ(a.pure, a.zipped_data)
+exe = EXE(pyz,
+          a.scripts,
+          exclude_binaries=True,
+          name=app_name,
+          debug=False,
+          console=True,
+          entrypoints=['pyi_entrypoint_a', 'pyi_entrypoint_b'])
+coll = COLLECT(exe,
+               a.binaries,
+               a.zipfiles,
+               a.datas,
+               name=app_name)
@@ -0,0 +1,26 @@
+# -*- mode: python -*-
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2019, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+
+app_name = "pyi_lazy_modules"
+
+a = Analysis(['../scripts/pyi_lazy_modules.py'])
+pyz = PYZ(a.pure, a.zipped_data,
+          lazy_modules=['csv', 'json'], lazy_excludes=['json.tool'])
+exe = EXE(pyz,
+          a.scripts,
+          exclude_binaries=True,
+          name=app_name,
+          debug=False,
+          console=True)
+coll = COLLECT(exe,
+               a.binaries,
+               a.zipfiles,
+               a.datas,
+               name=app_name)
@@ -0,0 +1,26 @@
+# -*- mode: python -*-
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2019, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+
+app_name = "pyi_zygote"
+
+a = Analysis(['../scripts/pyi_zygote.py'], hiddenimports=['csv'])
+pyz = PYZ(a.pure, a.zipped_data)
+exe = EXE(pyz,
+          a.scripts,
+          exclude_binaries=True,
+          name=app_name,
+          debug=False,
+          console=True,
+          zygote=['csv'])
+coll = COLLECT(exe,
+               a.binaries,
+               a.zipfiles,
+               a.datas,
+               name=app_name)
@@ -158,6 +158,11 @@ def test_feature_crypto(pyi_builder):
         assert type(key) is str
         # The test runner uses 'test_key' as key.
         assert key == 'test_key'.zfill(CRYPT_BLOCK_SIZE)
+
+        # Python 3 bootloaders decrypt the PYZ archive without PyCrypto.
+        import sys
+        if sys.version_info[0] > 2:
+            assert hasattr(sys, '_pyi_aes_cfb128_decrypt')
         """,
         pyi_args=['--key=test_key'])
 
@@ -519,6 +524,203 @@ def test_renamed_exe(pyi_builder):
 def test_spec_with_utf8(pyi_builder_spec):
     pyi_builder_spec.test_spec('spec-with-utf8.spec')
 
+@skipif(is_py2, reason="Python 2 imports all modules eagerly")
+def test_lazy_modules(pyi_builder_spec):
+    pyi_builder_spec.test_spec('pyi_lazy_modules.spec')
+
+@skipif(is_py2 or is_win, reason="Zygote mode needs Python 3 and POSIX")
+def test_zygote(pyi_builder_spec, tmpdir):
+    import ast
+    import resource
+    import subprocess
+    import time
+    import psutil
+
+    # The first run starts the zygote server in the background.
+    pyi_builder_spec.test_spec('pyi_zygote.spec')
+    exe = os.path.realpath(pyi_builder_spec._find_executables('pyi_zygote')[0])
+    result = tmpdir.join('result.txt')
+    env = dict(os.environ, PYI_ZYGOTE_RESULT=result.strpath,
+               PYI_ZYGOTE_VALUE='second run')
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    nofile = min(soft, 200)
+
+    def set_limits():
+        os.umask(0o027)
+        resource.setrlimit(resource.RLIMIT_NOFILE, (nofile, hard))
+
+    try:
+        # Wait until a run is served by the server.
+        for _ in range(40):
+            retcode = subprocess.call([exe, '7', 'an argument'],
+                                      cwd=tmpdir.strpath, env=env,
+                                      preexec_fn=set_limits)
+            state = ast.literal_eval(result.read())
+            if state['preloaded']:
+                break
+            time.sleep(0.5)
+        assert state['preloaded'], 'The zygote server did not serve the run.'
+        assert retcode == 7
+        assert state['cwd'] == os.path.realpath(tmpdir.strpath)
+        assert state['argv'] == ['7', 'an argument']
+        assert state['value'] == 'second run'
+        assert state['umask'] == 0o027
+        assert state['nofile'] == nofile
+    finally:
+        # Stop the server.
+        for process in psutil.process_iter():
+            try:
+                if process.exe() == exe:
+                    process.kill()
+            except psutil.Error:
+                pass
+
+def _use_pipelined_extraction(pyi_builder, monkeypatch):
+    # There is no command line option for EXE(pipelined_extraction=True).
+    if pyi_builder._mode != 'onefile':
+        pytest.skip('only --onefile')
+
+    import PyInstaller.building.build_main
+    EXE = PyInstaller.building.build_main.EXE
+
+    def MyEXE(*args, **kwargs):
+        kwargs['pipelined_extraction'] = True
+        return EXE(*args, **kwargs)
+
+    monkeypatch.setattr('PyInstaller.building.build_main.EXE', MyEXE)
+
+@skipif(is_py2 or is_win, reason="Pipelined extraction needs Python 3 and POSIX")
+def test_pipelined_extraction_extension(pyi_builder, monkeypatch, tmpdir):
+    # Binaries inside packages are extracted while the application starts,
+    # importing an extension module waits for them.
+    import _bisect
+    if not hasattr(_bisect, '__file__'):
+        pytest.skip('_bisect is a built-in module')
+    tmpdir.mkdir('pyi_deferred_pkg').join('__init__.py').write('')
+    _use_pipelined_extraction(pyi_builder, monkeypatch)
+    pyi_builder.test_source(
+        """
+        import os
+        import sys
+        import pyi_deferred_pkg._bisect as _bisect
+
+        pkgdir = os.path.join(sys._MEIPASS, 'pyi_deferred_pkg')
+        assert _bisect.__file__.startswith(pkgdir), _bisect.__file__
+        assert _bisect.bisect_left([1, 2, 3], 2) == 1
+        """,
+        ['--paths', tmpdir.strpath, '--hidden-import', 'pyi_deferred_pkg',
+         '--add-binary', _bisect.__file__ + os.pathsep + 'pyi_deferred_pkg'])
+
+@skipif(is_py2 or is_win, reason="Pipelined extraction needs Python 3 and POSIX")
+def test_pipelined_extraction_data(pyi_builder, monkeypatch, tmpdir):
+    # Data files are extracted while the application starts, open() and
+    # imports wait for them. Modules added as data files and distribution
+    # metadata are there from the start.
+    datadir = tmpdir.mkdir('pyi_deferred_data')
+    for i in range(20):
+        datadir.join('file%d.txt' % i).write('%d\n' % i * 10000)
+    moddir = tmpdir.mkdir('pyi_data_modules')
+    moddir.join('pyi_data_module.py').write('VALUE = 42\n')
+    moddir.mkdir('pyi_data_dist-1.0.dist-info').join('METADATA').write(
+        'Name: pyi_data_dist\nVersion: 1.0\n')
+    _use_pipelined_extraction(pyi_builder, monkeypatch)
+    pyi_builder.test_source(
+        """
+        import os
+        import sys
+
+        metadata = os.path.join(sys._MEIPASS, 'pyi_data_dist-1.0.dist-info',
+                                'METADATA')
+        assert os.path.exists(metadata)
+        import pyi_data_module
+        assert pyi_data_module.VALUE == 42
+
+        datadir = os.path.join(sys._MEIPASS, 'pyi_deferred_data')
+        for i in range(20):
+            with open(os.path.join(datadir, 'file%d.txt' % i)) as fp:
+                assert fp.read() == '%d\\n' % i * 10000
+        """,
+        ['--add-data', datadir.strpath + os.pathsep + 'pyi_deferred_data',
+         '--add-data', moddir.strpath + os.pathsep + '.'])
+
+@skipif(is_py2 or is_win, reason="Pipelined extraction needs Python 3 and POSIX")
+def test_pipelined_extraction_failure(pyi_builder, monkeypatch, tmpdir):
+    # When a deferred file cannot be extracted, the bootloader leaves a
+    # marker behind and open() fails instead of waiting forever.
+    import resource
+    import signal
+    import subprocess
+
+    # Sparse, and larger than the file size limit set below.
+    with open(tmpdir.join('pyi_big.dat').strpath, 'wb') as fp:
+        fp.truncate(256 << 20)
+    _use_pipelined_extraction(pyi_builder, monkeypatch)
+    pyi_builder.test_source(
+        """
+        import os
+        import sys
+
+        filename = os.path.join(sys._MEIPASS, 'pyi_big.dat')
+        marker = os.path.join(sys._MEIPASS, '.pyi-extraction-failed')
+        if os.environ.get('PYI_EXPECT_EXTRACTION_FAILURE'):
+            try:
+                open(filename, 'rb')
+            except OSError as e:
+                assert os.path.exists(marker)
+                print(e)
+            else:
+                raise RuntimeError('The extraction did not fail.')
+        else:
+            with open(filename, 'rb') as fp:
+                fp.seek(0, os.SEEK_END)
+                assert fp.tell() == 256 << 20
+        """,
+        ['--add-data', tmpdir.join('pyi_big.dat').strpath + os.pathsep + '.',
+         # Do not forward SIGXFSZ to the application.
+         '--bootloader-ignore-signals'])
+
+    def limit_file_size():
+        # Writing past the limit fails with EFBIG instead of a signal.
+        signal.signal(signal.SIGXFSZ, signal.SIG_IGN)
+        resource.setrlimit(resource.RLIMIT_FSIZE, (128 << 20, 128 << 20))
+
+    exe = pyi_builder._find_executables('test_pipelined_extraction_failure')[0]
+    env = dict(os.environ, PYI_EXPECT_EXTRACTION_FAILURE='1')
+    assert subprocess.call([exe], env=env, preexec_fn=limit_file_size) == 0
+
+@skipif(is_win, reason="Needs symbolic links")
+def test_entrypoints(pyi_builder_spec, tmpdir):
+    import subprocess
+
+    def run(args):
+        proc = subprocess.Popen(args, stdout=subprocess.PIPE,
+                                stderr=subprocess.PIPE,
+                                universal_newlines=True)
+        out, err = proc.communicate()
+        return proc.returncode, out.strip(), err
+
+    # Selected by the first argument, which becomes sys.argv[0].
+    pyi_builder_spec.test_spec('pyi_entrypoints.spec',
+                               app_args=['pyi_entrypoint_a', 'an argument'])
+    exe = os.path.realpath(pyi_builder_spec._find_executables('pyi_entrypoints')[0])
+    assert run([exe, 'pyi_entrypoint_a', 'x'])[:2] == \
+        (0, 'pyi_entrypoint_a pyi_entrypoint_a x')
+
+    # Selected by the base name of argv[0].
+    link = tmpdir.join('pyi_entrypoint_b').strpath
+    os.symlink(exe, link)
+    assert run([link, 'x', 'y'])[:2] == (0, 'pyi_entrypoint_b pyi_entrypoint_b x y')
+    # A program name takes precedence over the first argument.
+    assert run([link, 'pyi_entrypoint_a'])[:2] == \
+        (0, 'pyi_entrypoint_b pyi_entrypoint_b pyi_entrypoint_a')
+
+    # Neither names an entry point.
+    retcode, out, err = run([exe, 'pyi_entrypoint_c'])
+    assert retcode != 0
+    assert out == ''
+    assert 'Usage: pyi_entrypoints COMMAND' in err
+    assert 'pyi_entrypoint_a,pyi_entrypoint_b' in err
+
 @skipif_notosx
 def test_osx_override_info_plist(pyi_builder_spec):
     pyi_builder_spec.test_spec('pyi_osx_override_info_plist.spec')
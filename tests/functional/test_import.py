@@ -173,6 +173,31 @@ def test_import_non_existing_raises_import_error(pyi_builder):
             raise RuntimeError("ImportError not raised")
         """)
 
+
+@skipif(is_py2, reason="requires Python 3")
+def test_import_base_library_module(pyi_builder):
+    # The base library is frozen into the executable. Its modules still get
+    # __file__ (and __path__) below sys._MEIPASS, like the modules in the PYZ.
+    pyi_builder.test_source(
+        """
+        import os
+        import sys
+        import collections
+        import encodings.utf_8
+
+        def check(module, relpath):
+            filename = os.path.join(sys._MEIPASS, relpath)
+            assert module.__file__ == filename, module.__file__
+            assert module.__spec__.origin == filename, module.__spec__.origin
+            assert module.__spec__.has_location
+
+        # 'encodings' is imported while Python is initialized.
+        check(encodings, os.path.join('encodings', '__init__.pyc'))
+        assert encodings.__path__ == [os.path.join(sys._MEIPASS, 'encodings')]
+        check(encodings.utf_8, os.path.join('encodings', 'utf_8.pyc'))
+        check(collections, os.path.join('collections', '__init__.pyc'))
+        """)
+
 # :todo: Use some package which is already installed for some other
 # reason instead of `simplejson` which is only used here.
 @skipif(is_py3, reason="Python 3 doesn't use the CExtensionImporter, so it "
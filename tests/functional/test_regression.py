@@ -24,7 +24,7 @@ def test_issue_2492(monkeypatch, tmpdir):
                          'xref-file': str(tmpdir.join('imports.xref')),
                          'hiddenimports': [],
                          'specnm': 'issue_2492_script'})
-    # Speedup: avoid analyzing base_library.zip
+    # Speedup: avoid analyzing the base library
     monkeypatch.setattr(analysis, 'PY3_BASE_MODULES', [])
 
     script = tmpdir.join('script.py')
@@ -8,10 +8,13 @@
 #-----------------------------------------------------------------------------
 
 
+import marshal
 import pytest
 import os
+import sys
 
 from PyInstaller.building import utils
+from PyInstaller.compat import is_py2, EXTENSION_SUFFIXES
 
 def test_format_binaries_and_datas_not_found_raises_error(tmpdir):
     datas = [('non-existing.txt', '.')]
@@ -76,3 +79,79 @@ def test_format_binaries_and_datas_with_bracket(tmpdir):
 
     res = utils.format_binaries_and_datas(datas, str(tmpdir))
     assert res == expected
+
+
+@pytest.mark.skipif(is_py2, reason="Python 2 does not use the index")
+def test_write_extension_index(tmpdir):
+    ext = tmpdir.join('_speedups' + EXTENSION_SUFFIXES[0]).ensure()
+    toc = [('pkg.sub._speedups', str(ext), 'EXTENSION'),
+           ('pkg.missing', str(tmpdir.join('missing.egg', 'missing.so')),
+            'EXTENSION'),
+           ('libfoo.so', str(ext), 'BINARY')]
+    index = tmpdir.join('index.dat').strpath
+    assert utils.write_extension_index(index, toc) == 1
+    with open(index, 'rb') as fp:
+        assert marshal.load(fp) == {
+            'pkg.sub._speedups': os.path.join('pkg', 'sub', '_speedups' +
+                                              EXTENSION_SUFFIXES[0])}
+
+
+def test_slim_code(tmpdir):
+    source = ('"""Module docstring."""\n'
+              'def func(value):\n'
+              '    """Function docstring."""\n'
+              '    assert value, "no value"\n'
+              '    return "some text"\n'
+              'def other():\n'
+              '    return "some text"\n')
+    module = tmpdir.join('mod.py')
+    module.write(source)
+    filename = module.strpath
+    co = compile(source, filename, 'exec')
+
+    def run(co):
+        namespace = {}
+        exec(co, namespace)
+        return namespace
+
+    # Not selected: unchanged.
+    assert utils.slim_code('mod', filename, co,
+                           strip_docstrings=['other'], strip_asserts=['mo'],
+                           strip_line_numbers=['mod.sub']) is co
+
+    namespace = run(utils.slim_code('mod', filename, co,
+                                    strip_docstrings=['mod'],
+                                    strip_asserts=True))
+    assert namespace.get('__doc__') is None
+    assert namespace['func'].__doc__ is None
+    assert namespace['func'](0) == "some text"
+
+    slim = utils.slim_code('mod', filename, co, strip_line_numbers=True,
+                           merge_constants=True)
+    namespace = run(slim)
+    assert namespace['other']() is namespace['func'](1)
+    assert namespace['__doc__'] == "Module docstring."
+    with pytest.raises(AssertionError):
+        namespace['func'](0)
+    if sys.version_info < (3, 10):
+        assert len(marshal.dumps(slim)) < len(marshal.dumps(co))
+
+
+def test_slim_code_future_import(tmpdir):
+    # The docstring is deleted, ``from __future__`` stays the first statement.
+    source = ('"""Module docstring."""\n'
+              'from __future__ import division\n'
+              'def func():\n'
+              '    """Function docstring."""\n'
+              'HALF = 1 / 2\n')
+    module = tmpdir.join('mod.py')
+    module.write(source)
+    co = compile(source, module.strpath, 'exec')
+    namespace = {}
+    exec(utils.slim_code('mod', module.strpath, co, strip_docstrings=True,
+                         strip_asserts=False, strip_line_numbers=False,
+                         merge_constants=False), namespace)
+    assert namespace.get('__doc__') is None
+    assert namespace['func'].__doc__ is None
+    assert namespace['func']() is None
+    assert namespace['HALF'] == 0.5
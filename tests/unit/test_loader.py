@@ -8,10 +8,15 @@
 #-----------------------------------------------------------------------------
 
 
+import os
 from threading import Thread
 
+import pytest
+
+from PyInstaller.archive.writers import ZlibArchiveWriter
 from PyInstaller.compat import is_py2
-from PyInstaller.loader.pyimod02_archive import ArchiveFile
+from PyInstaller.loader.pyimod02_archive import ArchiveFile, ZlibArchiveReader, \
+    PYZ_TYPE_DATA, PYZ_TYPE_DATA_STORED
 
 if is_py2:
     from Queue import Queue
@@ -63,3 +68,143 @@ def test_threading_import(tmpdir):
     # Wait for the other thread to finish.
     thread.join()
 
+
+def _write_similar_modules(pyz, count, **kwargs):
+    toc = []
+    code_dict = {}
+    for i in range(count):
+        name = 'pkg%d.mod%d' % (i // 10, i)
+        source = ''.join('def func_%d_%d(self, value):\n'
+                         '    return self.attribute_%d + value * %d\n'
+                         % (i, j, j, i) for j in range(20))
+        code_dict[name] = compile(source, name + '.py', 'exec')
+        toc.append((name, name + '.py', 'PYMODULE'))
+    ZlibArchiveWriter(pyz, toc, code_dict=code_dict, **kwargs)
+    return code_dict
+
+
+@pytest.mark.skipif(is_py2, reason="Python 2 has no zlib preset dictionaries")
+def test_pyz_zdict(tmpdir):
+    """
+    Modules sharing most of their code are compressed with a preset
+    dictionary on request and read back unchanged.
+    """
+    pyz = tmpdir.join('test.pyz').strpath
+    _write_similar_modules(pyz, 50)
+    assert not ZlibArchiveReader(pyz).zdict
+    code_dict = _write_similar_modules(pyz, 50, zdict=True)
+
+    archive = ZlibArchiveReader(pyz)
+    assert archive.zdict
+    for name, code in code_dict.items():
+        typ, obj = archive.extract(name)
+        assert obj == code
+
+
+def test_pyz_blocks(tmpdir):
+    """
+    With a block size, modules are packed into shared compressed blocks and
+    read back unchanged, also when the block cache overflows.
+    """
+    pyz = tmpdir.join('test.pyz').strpath
+    code_dict = _write_similar_modules(pyz, 50, block_size=16384)
+
+    archive = ZlibArchiveReader(pyz)
+    blocks = set(entry[1] for entry in archive.toc.values()
+                 if len(entry) == 5)
+    assert 1 < len(blocks) < len(code_dict)
+    for name in sorted(code_dict) + sorted(code_dict, reverse=True):
+        typ, obj = archive.extract(name)
+        assert obj == code_dict[name]
+    assert len(archive._blocks) <= archive.BLOCK_CACHE_SIZE
+
+
+def test_pyz_concurrent_extract(tmpdir):
+    """
+    Several threads extract modules from the same archive at once.
+    """
+    pyz = tmpdir.join('test.pyz').strpath
+    code_dict = _write_similar_modules(pyz, 50, zdict=True)
+    archive = ZlibArchiveReader(pyz)
+    errors = []
+
+    def extract_all():
+        try:
+            for _ in range(10):
+                for name, code in code_dict.items():
+                    assert archive.extract(name)[1] == code
+        except Exception as e:
+            errors.append(e)
+
+    threads = [Thread(target=extract_all) for _ in range(8)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert not errors
+
+
+def test_pyz_data_stream(tmpdir):
+    """
+    Data entries are streamed from the archive: random data is stored as it
+    is, text is decompressed on the fly, and both can be read and seeked.
+    """
+    contents = {
+        'pkg/random.bin': os.urandom(300000),
+        'pkg/text.txt': b''.join(b'line %d\n' % (i % 100)
+                                 for i in range(20000)),
+    }
+    toc = []
+    for name, data in contents.items():
+        path = tmpdir.join(name.replace('/', '_')).strpath
+        with open(path, 'wb') as fp:
+            fp.write(data)
+        toc.append((name, path, 'DATA'))
+    pyz = tmpdir.join('test.pyz').strpath
+    ZlibArchiveWriter(pyz, toc, code_dict={})
+
+    archive = ZlibArchiveReader(pyz)
+    assert archive.toc['pkg/random.bin'][0] == PYZ_TYPE_DATA_STORED
+    assert archive.toc['pkg/text.txt'][0] == PYZ_TYPE_DATA
+    assert archive.open_entry('pkg') is None
+    for name, data in contents.items():
+        with archive.open_entry(name) as stream:
+            assert stream.read(5) == data[:5]
+            assert stream.read() == data[5:]
+            stream.seek(1000)
+            assert stream.read(10) == data[1000:1010]
+            assert stream.seek(-3, 2) == len(data) - 3
+            assert stream.read() == data[-3:]
+        assert archive.extract(name)[1] == data
+
+
+def test_pyz_uncompressed(tmpdir):
+    """
+    Without compression, modules and data are stored as they are, also with
+    a block size, and read back unchanged from the mapped archive.
+    """
+    pyz = tmpdir.join('test.pyz').strpath
+    data = b'some data\n' * 100
+    data_path = tmpdir.join('data.txt').strpath
+    with open(data_path, 'wb') as fp:
+        fp.write(data)
+    code_dict = _write_similar_modules(pyz, 20)
+    size = os.path.getsize(pyz)
+    toc = [(name, name + '.py', 'PYMODULE') for name in code_dict]
+    toc.append(('pkg/data.txt', data_path, 'DATA'))
+    ZlibArchiveWriter(pyz, toc, code_dict=code_dict, block_size=16384,
+                      compress=False)
+    assert os.path.getsize(pyz) > size
+
+    archive = ZlibArchiveReader(pyz)
+    assert not archive.compressed
+    assert not archive.zdict
+    for name, code in code_dict.items():
+        assert len(archive.toc[name]) == 3
+        assert archive.extract(name)[1] == code
+    assert archive.toc['pkg/data.txt'][0] == PYZ_TYPE_DATA_STORED
+    assert archive.extract('pkg/data.txt')[1] == data
+    with archive.open_entry('pkg/data.txt') as stream:
+        assert stream.read() == data
+    if not is_py2:
+        assert isinstance(archive._view, memoryview)